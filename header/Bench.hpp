@@ -0,0 +1,21 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include "Kernels.hpp"
+#include "Snapshot.hpp"
+#ifndef BENCH_HPP
+#define BENCH_HPP
+using namespace std;
+// Microbenchmarks behind the /bench command
+void bench(char* token, Snapshot* snapshot, int k);
+// Outputs of the kernels at level that differ from scalar; 0 if all match
+long check_kernels(KernelLevel level);
+// Fills words[4*q ..] with queries of two to four distinct words taken
+// from one random document each (picked by line number, so a reordered
+// index gets the same queries); returns how many were made
+int sample_queries(Mymap* map, int count, char** words, int* nwords);
+void free_queries(char** words, int* nwords, int n);
+// Fills words[2*p], words[2*p + 1] with adjacent word pairs from random
+// documents (so a pair comes up as often as it occurs); returns how many
+int sample_pairs(Mymap* map, int count, char** words);
+#endif
@@ -0,0 +1,45 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#ifndef BITMAP_HPP
+#define BITMAP_HPP
+using namespace std;
+// One bit per document. A word found in at least 1/16 of the documents
+// keeps its postings' docids as one of these instead of a sorted array
+// (see build_bitmaps() in Planner.cpp): at that df it is at most half the
+// size, and set operations run 64 documents per step. Such a bitmap also
+// gets a rank directory, a count of the bits before every 512, so the
+// position of a document in the list (where its tf is) takes one lookup
+// and at most eight popcounts.
+class Bitmap
+{
+    uint64_t *words;
+    int nwords;
+    int size;   // documents covered
+    int *ranks; // set bits before each block of RANK_WORDS words, NULL until build_ranks()
+public:
+    Bitmap(int size);
+    Bitmap(const int* ids, int count, int size);
+    ~Bitmap();
+    int get_size() const { return size; }
+    int get_nwords() const { return nwords; }
+    uint64_t word(int w) const { return words[w]; }  // documents 64w .. 64w+63
+    long bytes() const;
+    int test(int id) const { return (int)((words[id >> 6] >> (id & 63)) & 1); }
+    void set(int id) { words[id >> 6] |= (uint64_t)1 << (id & 63); }
+    void reset(int id) { words[id >> 6] &= ~((uint64_t)1 << (id & 63)); }
+    void fill();
+    void and_with(const Bitmap& other);
+    void or_with(const Bitmap& other);
+    void andnot_with(const Bitmap& other);
+    void and_ids(const int* ids, int count);
+    void andnot_ids(const int* ids, int count);
+    int cardinality() const;
+    int next(int from) const;
+    int decode(int* ids) const;
+    void build_ranks();
+    int rank(int id) const;
+    int count(int from, int to) const;
+};
+#endif
@@ -0,0 +1,18 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include "Snapshot.hpp"
+#include "Search.hpp"
+#include "Bench.hpp"
+#ifndef CHECK_HPP
+#define CHECK_HPP
+using namespace std;
+// Equivalence checks behind the searchengine_check program (ctest):
+// every fast path against the plain one it replaces. Each returns the
+// number of mismatches found, printing the first few.
+const int CHECK_QUERIES = 300;  // queries sampled per index
+const int CHECK_SLACK = 20;     // extra exact hits kept to judge ties at the k-th place
+// Every strategy the planner can pick for a sampled query against dense
+long check_strategies(Snapshot* snapshot);
+#endif
@@ -0,0 +1,19 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include "Maxheap.hpp"
+#include "Scorer.hpp"
+#include "Planner.hpp"
+#ifndef DAAT_HPP
+#define DAAT_HPP
+using namespace std;
+// Document-at-a-time evaluators for the daat, wand, conjunctive and
+// filtered plans.
+// They walk the plan's kept lists in docid order with one cursor each, so
+// unlike the dense evaluator they need no per-document arrays.
+// Returns the strategy that filled heap: a conjunctive plan whose k-th
+// score does not rule out partial matches is re-run as wand.
+PlanStrategy daat_evaluate(const QueryPlan* plan, ScorerType type, const TermContext& base,
+                           Maxheap* heap, EvalCounters* counters);
+#endif
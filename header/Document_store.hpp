@@ -1,5 +1,17 @@
 #include <iostream>
 #include "Trie.hpp"
 #include "Map.hpp"
+#include "Phrase.hpp"
+#ifndef DOCUMENT_STORE_HPP
+#define DOCUMENT_STORE_HPP
+using namespace std;
+long split(char* temp,int id,TrieNode* trie,Mymap* mymap,TrieNode* titles,BigramIndex* bigrams=NULL);
 int read_sizes(int *linecounter,int *maxlength, char *file_name);
-int read_input(Mymap* mymap,TrieNode* trie, char* file_name);
\ No newline at end of file
+int count_bigrams(Mymap* mymap, char* file_name, BigramIndex* bigrams);
+int read_input(Mymap* mymap,TrieNode* trie, char* file_name, TrieNode* titles=NULL, BigramIndex* bigrams=NULL);
+// Where index-building code prints: cout, unless this thread set its own
+// stream (a background /reload collects its messages and prints them when
+// it is done)
+ostream& build_log();
+void set_build_log(ostream* log);
+#endif
@@ -0,0 +1,30 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include "Map.hpp"
+#include "Trie.hpp"
+#include "Bitmap.hpp"
+#include "Phrase.hpp"
+#include "Planner.hpp"
+#ifndef FILTER_HPP
+#define FILTER_HPP
+using namespace std;
+// Boolean operators in /search queries:
+//   +word        documents must contain the word
+//   -word        documents must not contain it (it is not scored)
+//   "a b"        documents must contain the phrase, -"a b" must not
+//   \word        the rest of the word as typed (\-1, \"quoted)
+// They make one filter per query, built with word-parallel bitmap
+// operations; every strategy ranks only the documents in it.
+
+// Fills plan->terms[l].word and .required and plan->phrases from the
+// words as typed. excluded[l] is set for -words and the words of
+// -phrases, quoted[l] for the words of any phrase. Returns the number of
+// +/- operators outside phrases.
+int parse_operators(QueryPlan* plan, const char* const* words, int nwords, int* excluded, int* quoted);
+// plan->filter: all documents, AND every +word and phrase, minus every
+// -word and -phrase; NULL when the query has no operator and no phrase.
+// Terms must have been looked up.
+void build_filter(QueryPlan* plan, int operators, const int* quoted, TrieNode* trie, BigramIndex* bigrams,
+                  Mymap* map);
+#endif
@@ -0,0 +1,33 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include "Map.hpp"
+#include "Trie.hpp"
+#include "Scorer.hpp"
+#ifndef IMPACT_HPP
+#define IMPACT_HPP
+using namespace std;
+// Impact-ordered (and optionally pruned) postings for score-at-a-time
+// evaluation. Selected with -impact at startup:
+//   full          keep every posting, just reorder by impact
+//   global:<t>    drop postings whose impact is below t
+//   term:<f>      keep the best fraction f (0..1] of each term's postings
+enum ImpactMode
+{
+    IMPACT_OFF,
+    IMPACT_FULL,
+    IMPACT_GLOBAL,
+    IMPACT_TERM
+};
+struct ImpactOptions
+{
+    ImpactMode mode;
+    double value;
+};
+int parse_impact(const char* text, ImpactOptions* options);
+void build_impacts(TrieNode* trie, TrieNode* titles, Mymap* map, ScorerType type,
+                   ScorerParams params, ImpactOptions options);
+const int SAAT_MAX_K = 1000;  // larger k reads every list to the end
+int impact_accumulate(Postings** postings, int nterms, int k, double* acc, char* seen,
+                      int* candidates, int* slots, long* processed);
+#endif
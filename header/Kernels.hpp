@@ -0,0 +1,36 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#ifndef KERNELS_HPP
+#define KERNELS_HPP
+using namespace std;
+// Inner-loop kernels for postings decoding and BM25 scoring.
+// Every kernel has a scalar version plus SSE4.1 / AVX2 versions on x86;
+// the widest one the CPU supports is picked once at first use.
+enum KernelLevel
+{
+    KERNEL_SCALAR = 0,
+    KERNEL_SSE4 = 1,
+    KERNEL_AVX2 = 2
+};
+KernelLevel kernel_detect();
+KernelLevel kernel_level();
+void set_kernel_level(KernelLevel level);
+const char* kernel_name(KernelLevel level);
+
+// out[i] = idf * tf*(k1+1) / (tf + norms[ids[i]])
+// norms[d] is the precomputed k1*(1-b+b*doclen/avgdl) of document d
+void bm25_block(const int* ids, const int* tfs, const double* norms, int n,
+                double k1plus1, double idf, double* out);
+// Writes the positions i with scores[i] > threshold to out, returns how many
+int filter_above(const double* scores, int n, double threshold, int* out);
+// In-place prefix sum turning docid gaps back into docids
+void delta_decode(int* values, int n, int base);
+
+// Gap + varint coding of an ascending docid list (used for on-disk runs
+// and for measuring compressed postings size)
+int varint_encode(const int* ids, int n, unsigned char* out);
+int varint_decode(const unsigned char* in, int n, int* ids);
+int varint_size(const int* ids, int n);
+#endif
@@ -13,8 +13,10 @@ class listnode
         listnode(int docId):id(docId),times(1){next=NULL;}
         ~listnode();
         void add(int docId);
+        listnode* append(int docId);
         int search(int docId);
         int volume();
         int passdocuments(Scorelist* scorelist);
+        int flatten(int* ids, int* tfs);
 };
 #endif
\ No newline at end of file
@@ -10,25 +10,63 @@ class Mymap
     int buffersize;   // the length of the biggest document
     char **documents; // each document
     int *doc_lengths; // lengths of each document
+    double avgdl;     // average document length in words
+    double *norms;    // per-document BM25 length norm, see compute_norms()
+    int *title_lengths;   // words before the first tab of each document
+    double *title_norms;  // per-field norms for BM25F, see compute_field_norms()
+    double *body_norms;
+    int *original_ids;    // line number of each document after reorder()
+    int *internal_ids;    // inverse of original_ids
+    // Streaming builds (-batch-memory) keep documents on disk instead:
+    FILE *source;         // the input file, read on demand by getDocument()
+    long *offsets;        // where each trimmed document starts in source
+    int *text_lengths;    // its length in bytes
+    char *docbuffer;      // holds the last document read
+    const char* load(int i) const;
 public:
+    static char* trim(char* line, int* len);
     // Constructor
     Mymap(int size, int buffersize);
     ~Mymap();
     int insert(char* line,int i);
+    void set_source(FILE* file);
+    char* insert_offset(char* line, long offset, int i);
+    void compute_norms(double k1, double b);
+    void compute_field_norms(double b);
+    void reorder(const int* order);
+    // Input line number <-> docid; identity unless reorder() was called
+    int original_id(int id) const {
+        return original_ids != nullptr ? original_ids[id] : id;
+    }
+    int internal_id(int line) const {
+        if(line < 0 || line >= size)
+            return -1;
+        return internal_ids != nullptr ? internal_ids[line] : line;
+    }
     void setlength(int length, int id){
         doc_lengths[id]=length;
     }
     int getlength(int id ){
         return doc_lengths[id];
     }
+    void settitlelength(int length, int id){
+        title_lengths[id]=length;
+    }
     void print(int i){
         cout << "Document " << i << ": " << documents[i] << endl;
     }
+    double get_avgdl() const { return avgdl; }
+    const double* get_norms() const { return norms; }
+    const double* get_title_norms() const { return title_norms; }
+    const double* get_body_norms() const { return body_norms; }
+    // In streaming mode the pointer is only valid until the next call
     const char* getDocument(int i) const {
+        if(source != nullptr)
+            return load(i);
         return documents[i];
     }
     
-    const int get_size() const { return size;  }
-    const int get_buffersize() const { return buffersize; }
+    int get_size() const { return size;  }
+    int get_buffersize() const { return buffersize; }
 };
 #endif
\ No newline at end of file
@@ -30,6 +30,10 @@ class Maxheap
     double get_score(){
         return heap[0];
     }
+    double get_min();
+    void clear(){
+        curnumofscores = 0;
+    }
 
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#include "Map.hpp"
+#include "Trie.hpp"
+#include "Bitmap.hpp"
+#ifndef PHRASE_HPP
+#define PHRASE_HPP
+using namespace std;
+// Phrase queries ("a b" in /search) and the optional bigram index that
+// answers them from one short list per word pair. Selected with -bigrams:
+//   <n>           index the adjacent pairs seen at least n times (a
+//                 counting pass over the file runs before indexing)
+//   list:<file>   index the pairs in file, one "a b" per line
+// Without an entry for a pair the phrase is answered by intersecting the
+// words' lists and checking each remaining document's text.
+enum BigramMode
+{
+    BIGRAMS_OFF,
+    BIGRAMS_FREQUENT,
+    BIGRAMS_LIST
+};
+struct BigramOptions
+{
+    BigramMode mode;
+    int minimum;       // BIGRAMS_FREQUENT: occurrences a pair needs
+    const char* list;  // BIGRAMS_LIST: file of pairs
+};
+int parse_bigrams(const char* text, BigramOptions* options);
+
+// Postings of selected word pairs, keyed "first second" in a trie of
+// their own. Which pairs are selected is decided before split() runs:
+// count() every candidate, select() the ones counted at least minimum
+// times, then split() calls add() for every adjacent pair and only the
+// selected ones are indexed.
+// With a limit (-batch-memory) the count table never outgrows it: when
+// full, every count drops by one and pairs reaching 0 leave (Misra-Gries),
+// so a pair may be counted short by up to get_decrements(). A pair left
+// out is still answered, by the text check.
+class BigramIndex
+{
+    TrieNode* pairs;
+    uint64_t* keys;   // fingerprints of counted pairs, open addressing; freed by finalize()
+    int* counts;
+    long capacity;
+    long used;
+    int minimum;
+    long limit;       // bytes the count table may use, 0 = no limit
+    long decrements;
+    long slot(uint64_t key) const;
+    void rebuild(long newcapacity, int drop);
+public:
+    BigramIndex(int minimum);
+    ~BigramIndex();
+    void set_limit(long bytes) { limit = bytes; }
+    void count(const char* first, const char* second);
+    void select();
+    long add(const char* first, const char* second, int id);
+    void finalize();
+    Postings* find(const char* first, const char* second);
+    TrieNode* get_pairs() { return pairs; }
+    TrieNode* take_pairs();
+    long table_bytes() const { return capacity * (long)(sizeof(uint64_t) + sizeof(int)); }
+    long get_decrements() const { return decrements; }
+};
+int load_bigram_list(BigramIndex* bigrams, const char* path);
+// Narrows docs to the documents containing words[0..nwords) as
+// consecutive words. *indexed is set to the number of pairs answered by
+// the bigram index; returns how many documents had their text checked.
+long phrase_documents(const char* const* words, int nwords, TrieNode* trie, BigramIndex* bigrams,
+                      Mymap* map, Bitmap* docs, int* indexed);
+#endif
@@ -0,0 +1,124 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include "Map.hpp"
+#include "Trie.hpp"
+#include "Scorer.hpp"
+#include "Phrase.hpp"
+#ifndef PLANNER_HPP
+#define PLANNER_HPP
+using namespace std;
+// Cost-based query planning. plan_query() looks every word up once,
+// drops words whose IDF is not positive (they could only push documents
+// down), orders the rest rarest-first and picks the evaluation strategy
+// with the lowest estimated cost, counted in postings touched:
+//   dense        term-at-a-time into an accumulator over all documents
+//   daat         document-at-a-time union of the lists, no per-document arrays
+//   wand         daat that skips documents whose score upper bound cannot
+//                reach the current k-th best
+//   conjunctive  intersect the lists rarest-first; kept only if the k-th
+//                score proves no partial match could rank (else wand)
+//   impact       score-at-a-time over impact-ordered lists (-impact)
+//   filtered     visit only the documents the boolean filter allows and
+//                skip every list to them (selective phrases, +words)
+// +word, -word and "a b" make a boolean filter (Filter.hpp); only
+// documents in it are ranked. The words of a phrase are scored like any
+// other.
+// A page after the first carries the last hit of the previous one and
+// every strategy ranks only the hits that come after it.
+const int PLAN_MAX_TERMS = 10;
+const int PLAN_WORD_LENGTH = 256;  // longer words are cut
+const double IDF_FLOOR = 0.01;  // IDF used when every word is that common
+
+enum PlanStrategy
+{
+    PLAN_DENSE,
+    PLAN_DAAT,
+    PLAN_WAND,
+    PLAN_CONJUNCTIVE,
+    PLAN_IMPACT,
+    PLAN_FILTERED,
+    PLAN_STRATEGIES
+};
+
+enum TermStatus
+{
+    TERM_KEPT,
+    TERM_MISSING,   // not in the index
+    TERM_DROPPED,   // IDF <= 0
+    TERM_FLOORED,   // IDF <= 0 but kept at IDF_FLOOR (no better word)
+    TERM_EXCLUDED   // -word: filter only, not scored
+};
+
+struct PlanTerm
+{
+    char word[PLAN_WORD_LENGTH];  // without +, - and quotes
+    Postings* body;
+    Postings* title;  // title-field postings, BM25F only
+    int df;
+    double idf;       // as the scorer defines it
+    double weight;    // IDF actually used (idf or IDF_FLOOR)
+    double upper;     // no posting of this word scores more
+    TermStatus status;
+    int required;     // +word
+};
+
+// Words terms[first .. first+count) in quotes
+struct PlanPhrase
+{
+    int first;
+    int count;
+    int excluded;   // -"a b"
+    int indexed;    // pairs answered from the bigram index
+    long checked;   // documents whose text was checked
+    int documents;  // documents containing the phrase (among those still allowed)
+};
+
+// Last hit of the previous page; hits are ordered by score, then docid
+struct SearchAfter
+{
+    double score;
+    int id;  // -1 on the first page
+};
+const SearchAfter FIRST_PAGE = {0, -1};
+
+struct QueryPlan
+{
+    PlanTerm terms[PLAN_MAX_TERMS];  // as typed
+    int nterms;
+    int order[PLAN_MAX_TERMS];       // kept terms, rarest first
+    int nkept;
+    long postings;                   // sum of df over kept terms
+    double estimates[PLAN_STRATEGIES];  // -1 if not applicable
+    PlanStrategy strategy;
+    PlanPhrase phrases[PLAN_MAX_TERMS];
+    int nphrases;
+    Bitmap* filter;                  // documents +word/-word/phrases allow, NULL = all
+    SearchAfter after;
+};
+
+// Whether a hit belongs on this page, i.e. ranks below plan->after
+inline int plan_admits(const QueryPlan* plan, double score, int doc)
+{
+    return plan->after.id < 0 || score < plan->after.score ||
+           (score == plan->after.score && doc > plan->after.id);
+}
+
+// Work done by an evaluator, in the units of the cost model
+struct EvalCounters
+{
+    long scored;  // postings scored
+    long probes;  // binary-search steps spent skipping
+};
+
+const int BITMAP_DENSITY = 16;  // words in at least 1/16 of the documents get a bitmap
+
+void compute_max_weights(TrieNode* trie, TrieNode* titles, Mymap* map, ScorerType type, ScorerParams params);
+void build_bitmaps(TrieNode* trie, Mymap* map);
+void plan_query(QueryPlan* plan, const char* const* words, int nwords, TrieNode* trie, TrieNode* titles,
+                BigramIndex* bigrams, Mymap* map, ScorerType type, int k, int impacts, SearchAfter after);
+void release_plan(QueryPlan* plan);
+const char* strategy_name(PlanStrategy strategy);
+double strategy_cost(PlanStrategy strategy, const QueryPlan* plan, long scored, long probes, int N);
+#endif
@@ -0,0 +1,46 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include "Listnode.hpp"
+#include "Bitmap.hpp"
+#ifndef POSTINGS_HPP
+#define POSTINGS_HPP
+using namespace std;
+// Frozen, contiguous posting list of one term.
+// listnode chains are cheap to append to while indexing; once read_input()
+// is done every chain is copied into two parallel arrays so the scoring
+// kernels can walk them block by block. A high-df word then trades its id
+// array for a bitmap (to_bitmap()); its tfs stay an array, in docid order.
+class Postings
+{
+    int *ids;   // document ids, ascending; NULL once they are a bitmap
+    int *tfs;   // term frequency per document
+    int count;  // number of documents (df)
+    // Optional impact-ordered copy (see Impact.cpp): precomputed score
+    // contribution per posting, highest first, possibly pruned
+    int *impact_ids;
+    double *impacts;
+    int impact_count;
+    double max_weight;  // best score of any posting at idf 1 (see Planner.cpp)
+    Bitmap *bitmap;     // the ids instead, only for high-df words
+public:
+    Postings(listnode* list);
+    Postings(int* ids, int* tfs, int count);
+    ~Postings();
+    int position(int docId) const;
+    int search(int docId) const;
+    int get_count() const { return count; }
+    const int* get_ids() const { return ids; }  // NULL for a bitmap word, see decode_ids()
+    const int* decode_ids(int* buffer) const;
+    const int* get_tfs() const { return tfs; }
+    void remap(const int* newid);
+    void set_impacts(int* ids, double* impacts, int n);
+    int get_impact_count() const { return impact_count; }
+    const int* get_impact_ids() const { return impact_ids; }
+    const double* get_impacts() const { return impacts; }
+    void set_max_weight(double weight) { max_weight = weight; }
+    double get_max_weight() const { return max_weight; }
+    void to_bitmap(int N);
+    const Bitmap* get_bitmap() const { return bitmap; }
+};
+#endif
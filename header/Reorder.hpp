@@ -0,0 +1,24 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include "Map.hpp"
+#include "Trie.hpp"
+#ifndef REORDER_HPP
+#define REORDER_HPP
+using namespace std;
+// Optional docid reordering pass, run after read_input() and before any
+// scoring data is derived from docids (-reorder on the command line):
+//   text   sort documents by their text (groups near-duplicates and
+//          documents sharing a title prefix, like a URL sort)
+//   bp     recursive graph bisection: repeatedly split the collection so
+//          documents sharing words land in the same half
+// Mymap keeps the original line numbers for /tf and result output.
+enum ReorderMode
+{
+    REORDER_NONE,
+    REORDER_TEXT,
+    REORDER_BP
+};
+int parse_reorder(const char* text, ReorderMode* mode);
+void reorder_documents(TrieNode* trie, TrieNode* titles, TrieNode* pairs, Mymap* map, ReorderMode mode);
+#endif
@@ -0,0 +1,41 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#ifndef RESULTWRITER_HPP
+#define RESULTWRITER_HPP
+using namespace std;
+// How much of each hit /search prints (-output on the command line)
+enum OutputMode
+{
+    OUTPUT_FULL,     // header line + whole document (the original format)
+    OUTPUT_TITLE,    // header line only
+    OUTPUT_SNIPPET,  // header line + a few words around the first match
+    OUTPUT_IDS       // "line score" per hit
+};
+int parse_output(const char* text, OutputMode* mode);
+
+// Formats a whole result page into one reusable buffer and hands it to
+// the OS with a single write, instead of one flush per endl.
+class ResultWriter
+{
+    char *buffer;
+    size_t length;
+    size_t capacity;
+    OutputMode mode;
+    void reserve(size_t extra);
+    void append(const char* text, size_t len);
+    void append(const char* text);
+    void snippet(const char* document, const char* const* words, int nwords);
+public:
+    ResultWriter(OutputMode mode);
+    ~ResultWriter();
+    void set_mode(OutputMode newmode) { mode = newmode; }
+    OutputMode get_mode() const { return mode; }
+    void clear() { length = 0; }
+    void add(int id, double score, const char* document, const char* const* words, int nwords);
+    void separator();
+    void line(const char* text);
+    int flush();
+};
+#endif
@@ -0,0 +1,148 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include "Kernels.hpp"
+#include "Postings.hpp"
+#ifndef SCORER_HPP
+#define SCORER_HPP
+using namespace std;
+// Ranking functions as compile-time policies.
+// search() instantiates its evaluator once per policy, so the inner loop
+// never branches on the model and each policy's constants are folded in.
+// Only k1 and b stay runtime values (-k1 / -b on the command line).
+enum ScorerType
+{
+    SCORER_BM25,
+    SCORER_BM25PLUS,
+    SCORER_TFIDF,
+    SCORER_BM25F
+};
+struct ScorerParams
+{
+    float k1;
+    float b;
+};
+int parse_scorer(const char* name, ScorerType* type);
+const char* scorer_name(ScorerType type);
+
+// Everything a policy may read while scoring one term.
+// weights() scores a whole list; score() scores the i-th posting alone,
+// document doc (for document-at-a-time evaluation), and gives the same
+// value.
+struct TermContext
+{
+    const Postings* body;    // postings over the whole document
+    const int* ids;          // its docids for weights(), decoded if a bitmap
+    const Postings* title;   // postings over the title field, may be NULL
+    const double* norms;     // k1*(1-b+b*doclen/avgdl) per document
+    const double* title_norms; // (1-b+b*titlelen/avgtitlelen) per document
+    const double* body_norms;  // (1-b+b*bodylen/avgbodylen) per document
+    ScorerParams params;
+};
+
+// Okapi BM25 (the original hard-coded ranking)
+struct BM25
+{
+    static const bool uses_titles = false;
+    static double idf(double N, double df){
+        return log((N - df + 0.5) / (df + 0.5));
+    }
+    static void weights(const TermContext& t, double idf, double* out){
+        bm25_block(t.ids, t.body->get_tfs(), t.norms, t.body->get_count(),
+                   t.params.k1 + 1.0, idf, out);
+    }
+    static double score(const TermContext& t, double idf, int i, int doc){
+        double tf = (double)t.body->get_tfs()[i];
+        return idf * ((tf * (t.params.k1 + 1.0)) / (tf + t.norms[doc]));
+    }
+};
+
+// BM25+ : lower-bounds the tf part by delta so long documents that
+// contain the term always beat documents that do not
+struct BM25Plus
+{
+    static const bool uses_titles = false;
+    static double idf(double N, double df){
+        return log((N + 1.0) / df);
+    }
+    static void weights(const TermContext& t, double idf, double* out){
+        const double delta = 1.0;
+        int n = t.body->get_count();
+        bm25_block(t.ids, t.body->get_tfs(), t.norms, n,
+                   t.params.k1 + 1.0, idf, out);
+        for(int i = 0; i < n; i++){
+            out[i] += idf * delta;
+        }
+    }
+    static double score(const TermContext& t, double idf, int i, int doc){
+        const double delta = 1.0;
+        return BM25::score(t, idf, i, doc) + idf * delta;
+    }
+};
+
+// Classic log-scaled TF-IDF, no length normalisation
+struct TfIdf
+{
+    static const bool uses_titles = false;
+    static double idf(double N, double df){
+        return log(N / df);
+    }
+    static void weights(const TermContext& t, double idf, double* out){
+        const int* tfs = t.body->get_tfs();
+        int n = t.body->get_count();
+        for(int i = 0; i < n; i++){
+            out[i] = (1.0 + log((double)tfs[i])) * idf;
+        }
+    }
+    static double score(const TermContext& t, double idf, int i, int){
+        return (1.0 + log((double)t.body->get_tfs()[i])) * idf;
+    }
+};
+
+// BM25F over two fields: the title (text before the first tab of a
+// line) and the rest of the document. Title hits count titleweight times.
+struct BM25F
+{
+    static const bool uses_titles = true;
+    static double idf(double N, double df){
+        return BM25::idf(N, df);
+    }
+    // A field the word is not in adds nothing. Its norm may be 0 (an
+    // empty field with b = 1), so it is never divided by.
+    static double field_tf(double weight, double tf, double norm){
+        return tf > 0 ? weight * tf / norm : 0;
+    }
+    static void weights(const TermContext& t, double idf, double* out){
+        const double titleweight = 2.0;
+        const double k1 = t.params.k1;
+        const int* ids = t.ids;
+        const int* tfs = t.body->get_tfs();
+        int n = t.body->get_count();
+        const int* tids = t.title != NULL ? t.title->get_ids() : NULL;
+        int tcount = t.title != NULL ? t.title->get_count() : 0;
+        int j = 0;  // both lists are ascending: merge instead of searching
+        for(int i = 0; i < n; i++){
+            int id = ids[i];
+            double titletf = 0;
+            while(j < tcount && tids[j] < id){
+                j++;
+            }
+            if(j < tcount && tids[j] == id){
+                titletf = (double)t.title->get_tfs()[j];
+            }
+            double bodytf = (double)tfs[i] - titletf;
+            double tf = field_tf(titleweight, titletf, t.title_norms[id]) + field_tf(1.0, bodytf, t.body_norms[id]);
+            out[i] = idf * (tf * (k1 + 1.0)) / (k1 + tf);
+        }
+    }
+    static double score(const TermContext& t, double idf, int i, int id){
+        const double titleweight = 2.0;
+        const double k1 = t.params.k1;
+        double titletf = t.title != NULL ? (double)t.title->search(id) : 0;
+        double bodytf = (double)t.body->get_tfs()[i] - titletf;
+        double tf = field_tf(titleweight, titletf, t.title_norms[id]) + field_tf(1.0, bodytf, t.body_norms[id]);
+        return idf * (tf * (k1 + 1.0)) / (k1 + tf);
+    }
+};
+#endif
@@ -6,6 +6,15 @@
 #include "Map.hpp"
 #include "Trie.hpp"
 #include "Maxheap.hpp"
+#include "Kernels.hpp"
+#include "Scorer.hpp"
+#include "Impact.hpp"
+#include "ResultWriter.hpp"
+#include "Snapshot.hpp"
+#include "Planner.hpp"
+#include "Daat.hpp"
+#include <chrono>
+#include <iomanip>
 #ifdef _WIN32
     #include <windows.h>
 #else
@@ -16,7 +25,13 @@
 using namespace std;
 
 // Function declarations
-void search(char* token, TrieNode *trie, Mymap *map, int k);
+void search_init(ScorerType type, ScorerParams params);
+void search(char* token, Snapshot *snapshot, int k);
+void search_set_output(OutputMode mode);
+void recall(Snapshot *snapshot, int k);
+void explain(Snapshot *snapshot, int k);
 void df(TrieNode* trie);
-int tf(char* token, TrieNode* trie);
+void plan_words(QueryPlan *plan, const char* const* words, int nwords, Snapshot *snapshot, int k, SearchAfter after);
+PlanStrategy run_query(const QueryPlan *plan, Snapshot *snapshot, int k, Maxheap *heap, EvalCounters *counters);
+int tf(char* token, TrieNode* trie, Mymap* map);
 
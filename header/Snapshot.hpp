@@ -0,0 +1,74 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <mutex>
+#include <thread>
+#include "Map.hpp"
+#include "Trie.hpp"
+#include "Scorer.hpp"
+#include "Impact.hpp"
+#include "Reorder.hpp"
+#include "Document_store.hpp"
+#include "Spimi.hpp"
+#include "Planner.hpp"
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+using namespace std;
+// How every index is built (from the command line, same for each reload)
+struct IndexOptions
+{
+    ScorerType scorer;
+    ScorerParams params;
+    ImpactOptions impact;
+    ReorderMode reorder;
+    long batch_memory;  // bytes per indexing batch, 0 = all in memory
+    BigramOptions bigrams;
+};
+// One complete, read-only index: documents, postings and the title
+// field. Commands take a reference with acquire_snapshot() and give it
+// back with release_snapshot(); after /reload publishes a newer one the
+// old snapshot is deleted once its last reference is released.
+class Snapshot
+{
+    Mymap* map;
+    TrieNode* trie;
+    TrieNode* titles;  // NULL unless the scorer needs the title field
+    BigramIndex* bigrams;  // NULL unless -bigrams
+    int impacts;       // postings carry impact-ordered lists
+    int lines;
+    int maxlength;
+    char* path;
+    unsigned int id;   // differs for every snapshot built, also across runs
+    int refs;          // guarded by the lock in Snapshot.cpp
+
+public:
+    Snapshot(Mymap* map, TrieNode* trie, TrieNode* titles, BigramIndex* bigrams, int impacts, int lines,
+             int maxlength, const char* path);
+    ~Snapshot();
+    Mymap* get_map() { return map; }
+    TrieNode* get_trie() { return trie; }
+    TrieNode* get_titles() { return titles; }
+    BigramIndex* get_bigrams() { return bigrams; }
+    int uses_impacts() { return impacts; }
+    int get_lines() { return lines; }
+    int get_maxlength() { return maxlength; }
+    const char* get_path() { return path; }
+    unsigned int get_id() { return id; }
+    friend Snapshot* acquire_snapshot();
+    friend void release_snapshot(Snapshot* snapshot);
+    friend void publish_snapshot(Snapshot* snapshot);
+};
+void snapshot_init(IndexOptions options);
+Snapshot* build_snapshot(const char* path);
+void publish_snapshot(Snapshot* snapshot);
+Snapshot* acquire_snapshot();
+void release_snapshot(Snapshot* snapshot);
+// Background rebuild: /reload <path>, or SIGHUP to re-read the current file
+int start_reload(const char* path);
+// Held while a command prints so reload messages come between commands
+void lock_output();
+void unlock_output();
+void reload_watch_signal();
+void reload_shutdown();
+#endif
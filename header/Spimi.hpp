@@ -0,0 +1,22 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include "Map.hpp"
+#include "Trie.hpp"
+#include "Phrase.hpp"
+#ifndef SPIMI_HPP
+#define SPIMI_HPP
+using namespace std;
+// Batched index build (-batch-memory <MB>): single-pass in-memory
+// indexing (SPIMI). Documents are indexed into batch tries (body, titles,
+// bigram pairs) until a batch, frozen for writing, would reach the
+// budget, then the batch is written to a temporary file as a sorted run
+// of (word, postings). Runs are merged 64 at a time as they pile up, and
+// the rest are k-way merged at the end with sequential reads straight
+// into compact Postings. Document text is not kept in memory; Mymap
+// reads it back on demand. The budget bounds one batch, not the process:
+// the merged index stays in memory and grows with the file.
+int read_input_streaming(Mymap* mymap, TrieNode* trie, char* file_name, TrieNode* titles, BigramIndex* bigrams,
+                         long budget);
+#endif
@@ -0,0 +1,12 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include "Map.hpp"
+#include "Trie.hpp"
+#include "Phrase.hpp"
+#ifndef STATS_HPP
+#define STATS_HPP
+using namespace std;
+// Index size report behind the /stats command
+void stats(TrieNode* trie, Mymap* map, BigramIndex* bigrams);
+#endif
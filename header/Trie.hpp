@@ -3,23 +3,34 @@
 #include <cstring>
 #include "Listnode.hpp"
 #include "Score.hpp"
+#include "Postings.hpp"
 #ifndef TRIE_HPP
 #define TRIE_HPP
 using namespace std;
+// Called once per indexed word by TrieNode::visit()
+typedef void (*TermVisitor)(const char* word, Postings* postings, void* arg);
+// Heap bytes behind an allocation of size bytes, malloc overhead included
+long heap_bytes(size_t size);
 class TrieNode
 {
     char value;
     TrieNode *sibling;
     TrieNode *child;
-    listnode* list;
+    listnode* list;     // postings while indexing
+    listnode* tail;     // last node of list, where the next document goes
+    Postings* postings; // frozen postings after finalize()
 public:
     TrieNode();
     ~TrieNode();
-    void insert(char* token, int id);
+    long insert(char* token, int id);
     int dfsearchword(char* word, int curr, int wordlen);
     int tfsearchword(int id, char* word, int curr, int wordlen);
     // void searchall(char* buffer, int curr);  // Disabled: memory corruption issue
-    void search(char* word, int curr, Scorelist* scorelist);
+    void finalize();
+    Postings* find(char* word, int curr, int wordlen);
+    void lookup(const char* const* words, int nwords, Postings** results);
+    void visit(char* buffer, int curr, TermVisitor visitor, void* arg);
+    void attach(const char* word, Postings* postings);
 };
 
 #endif
\ No newline at end of file
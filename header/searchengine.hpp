@@ -8,8 +8,13 @@
 #include "Map.hpp"
 #include "Trie.hpp"
 #include "Search.hpp"
+#include "Bench.hpp"
+#include "Stats.hpp"
+#include "Reorder.hpp"
+#include "Spimi.hpp"
+#include "Snapshot.hpp"
 
 // Function declaration
-int inputmanager(char* input, TrieNode* trie, Mymap* mymap, int k);
+int inputmanager(char* input, int k);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,645 @@
+#include "Bench.hpp"
+#include "Search.hpp"
+#include <chrono>
+#include <iomanip>
+#include <cmath>
+using namespace std;
+
+const int BENCH_POSTINGS = 1 << 20;  // Synthetic postings per run
+const int BENCH_ROUNDS = 20;         // Runs averaged per kernel
+const int BENCH_LOOKUPS = 1 << 18;   // Dictionary lookups per run
+const int LOOKUP_ROUNDS = 3;         // Runs averaged per batch size
+const int BENCH_PHRASES = 2000;      // Two-word phrases sampled from the text
+const int BENCH_QUERIES = 500;       // Queries sampled from the text for /bench impact|intersect
+const int INTERSECT_ROUNDS = 4;      // Runs per query; the fastest is reported
+
+static double elapsed_ns(chrono::steady_clock::time_point start)
+{
+    return (double)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+}
+
+static long random_below(long n)
+{
+    return ((long)rand() * (RAND_MAX + 1L) + rand()) % n;
+}
+
+// Runs every kernel at level and at scalar on the same input, for every
+// length up to CHECK_LENGTHS (so each SIMD tail is covered) and one long
+// odd one, and counts the outputs that differ. Scores are compared bit
+// for bit: the SIMD paths do the same IEEE operations in the same order.
+long check_kernels(KernelLevel level)
+{
+    const int CHECK_LENGTHS = 67;
+    const int longest = 4099;
+    int *ids = (int*)malloc(longest*sizeof(int));
+    int *tfs = (int*)malloc(longest*sizeof(int));
+    int *expected = (int*)malloc(longest*sizeof(int));
+    int *actual = (int*)malloc(longest*sizeof(int));
+    double *norms = (double*)malloc(longest*sizeof(double));
+    double *scores = (double*)malloc(longest*sizeof(double));
+    double *wanted = (double*)malloc(longest*sizeof(double));
+    unsigned char *bytes = (unsigned char*)malloc(5*longest);
+    KernelLevel saved = kernel_level();
+    long bad = 0;
+    srand(7);
+    for(int n = 0; n <= CHECK_LENGTHS + 1; n++){
+        int length = n <= CHECK_LENGTHS ? n : longest;
+        for(int i = 0; i < length; i++){
+            ids[i] = (int)random_below(length);
+            tfs[i] = 1 + rand() % 50;
+            norms[i] = 0.1 + (rand() % 100000) / 10000.0;
+        }
+
+        set_kernel_level(KERNEL_SCALAR);
+        bm25_block(ids, tfs, norms, length, 2.2, 1.7, wanted);
+        set_kernel_level(level);
+        bm25_block(ids, tfs, norms, length, 2.2, 1.7, scores);
+        bad += length > 0 && memcmp(wanted, scores, length*sizeof(double)) != 0;
+
+        double threshold = length > 0 ? wanted[length / 2] : 0;  // ties with the threshold too
+        set_kernel_level(KERNEL_SCALAR);
+        int kept = filter_above(wanted, length, threshold, expected);
+        set_kernel_level(level);
+        bad += filter_above(wanted, length, threshold, actual) != kept ||
+               memcmp(expected, actual, kept*sizeof(int)) != 0;
+
+        int base = rand() % 1000;
+        for(int i = 0; i < length; i++){
+            expected[i] = actual[i] = rand() % 100;
+        }
+        set_kernel_level(KERNEL_SCALAR);
+        delta_decode(expected, length, base);
+        set_kernel_level(level);
+        delta_decode(actual, length, base);
+        bad += memcmp(expected, actual, length*sizeof(int)) != 0;
+
+        // Gaps of one to four varint bytes, mostly one so the SIMD
+        // paths meet runs of 16 and 32 one-byte gaps and their ends
+        int doc = 0;
+        for(int i = 0; i < length; i++){
+            int size = rand() % 8 != 0 ? 1 : 2 + rand() % 3;
+            doc += 1 + (int)random_below(1L << (7 * size - 1));
+            expected[i] = doc;
+        }
+        int encoded = varint_encode(expected, length, bytes);
+        bad += varint_decode(bytes, length, actual) != encoded ||
+               memcmp(expected, actual, length*sizeof(int)) != 0;
+    }
+    set_kernel_level(saved);
+    free(ids);
+    free(tfs);
+    free(expected);
+    free(actual);
+    free(norms);
+    free(scores);
+    free(wanted);
+    free(bytes);
+    return bad;
+}
+
+// Times every kernel at each SIMD level the CPU supports and prints
+// nanoseconds per posting, after checking that level against scalar.
+// Usage: /bench [kernels]
+static void bench_kernels()
+{
+    int n = BENCH_POSTINGS;
+    int *ids = (int*)malloc(n*sizeof(int));
+    int *tfs = (int*)malloc(n*sizeof(int));
+    int *work = (int*)malloc(n*sizeof(int));
+    int *passed = (int*)malloc(n*sizeof(int));
+    double *norms = (double*)malloc(n*sizeof(double));
+    double *scores = (double*)malloc(n*sizeof(double));
+    unsigned char *bytes = (unsigned char*)malloc(5*n);
+
+    // Ascending docids with small gaps for the decoders, then the same
+    // array reused as scattered ids so the BM25 gathers miss the cache
+    srand(42);
+    int doc = 0;
+    for(int i = 0; i < n; i++){
+        doc += 1 + rand() % 4;
+        ids[i] = doc;
+        tfs[i] = 1 + rand() % 8;
+        norms[i] = 0.3 + (rand() % 1000) / 1000.0;
+    }
+    int encoded = varint_encode(ids, n, bytes);
+    for(int i = 0; i < n; i++){
+        ids[i] = (int)(((long long)i * 7919) % n);
+    }
+
+    KernelLevel saved = kernel_level();
+    KernelLevel best = kernel_detect();
+    cout << "Kernel microbenchmark: " << n << " postings x " << BENCH_ROUNDS << " rounds (ns/posting)" << endl;
+    cout << "level    bm25     filter   delta    varint   vs scalar" << endl;
+    for(int level = KERNEL_SCALAR; level <= best; level++){
+        long bad = check_kernels((KernelLevel)level);
+        set_kernel_level((KernelLevel)level);
+        double t[4] = {0, 0, 0, 0};
+        int kept = 0;
+        for(int r = 0; r < BENCH_ROUNDS; r++){
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            bm25_block(ids, tfs, norms, n, 2.2, 1.5, scores);
+            t[0] += elapsed_ns(start);
+
+            start = chrono::steady_clock::now();
+            kept += filter_above(scores, n, 2.5, passed);
+            t[1] += elapsed_ns(start);
+
+            for(int i = 0; i < n; i++){
+                work[i] = 1;
+            }
+            start = chrono::steady_clock::now();
+            delta_decode(work, n, 0);
+            t[2] += elapsed_ns(start);
+
+            start = chrono::steady_clock::now();
+            varint_decode(bytes, n, work);
+            t[3] += elapsed_ns(start);
+        }
+        cout << left << setw(8) << kernel_name((KernelLevel)level);
+        for(int j = 0; j < 4; j++){
+            cout << " " << setw(8) << fixed << setprecision(3) << t[j] / BENCH_ROUNDS / n;
+        }
+        cout.unsetf(ios::fixed);
+        cout << right << setprecision(6) << " ";
+        if(bad == 0)
+            cout << "same" << endl;
+        else
+            cout << bad << " mismatch(es)" << endl;
+        if(kept < 0){
+            cout << kept << endl;  // keep the filter result alive
+        }
+    }
+    cout << "varint postings: " << encoded << " bytes (" << (double)encoded / n << " bytes/posting)" << endl;
+    set_kernel_level(saved);
+
+    free(ids);
+    free(tfs);
+    free(work);
+    free(passed);
+    free(norms);
+    free(scores);
+    free(bytes);
+}
+
+struct WordList
+{
+    char **words;
+    int count;
+    int capacity;
+};
+
+static void collect_word(const char* word, Postings*, void* arg)
+{
+    WordList* list = (WordList*)arg;
+    if(list->count == list->capacity){
+        list->capacity = list->capacity > 0 ? 2 * list->capacity : 1024;
+        list->words = (char**)realloc(list->words, list->capacity*sizeof(char*));
+    }
+    list->words[list->count] = (char*)malloc(strlen(word) + 1);
+    strcpy(list->words[list->count], word);
+    list->count++;
+}
+
+// Looks up random indexed words one at a time with find() and in
+// batches with lookup(), reading each word's df and first docid the way
+// a query does, and prints nanoseconds per word. Usage: /bench lookup
+static void bench_lookup(TrieNode* trie, Mymap* map)
+{
+    WordList list = {NULL, 0, 0};
+    char* buffer = (char*)malloc((map->get_buffersize() + 2)*sizeof(char));
+    trie->visit(buffer, 0, collect_word, &list);
+    free(buffer);
+    if(list.count == 0){
+        cout << "No words indexed" << endl;
+        return;
+    }
+
+    int n = BENCH_LOOKUPS;
+    const char **stream = (const char**)malloc(n*sizeof(char*));
+    Postings **found = (Postings**)malloc(n*sizeof(Postings*));
+    srand(42);
+    for(int i = 0; i < n; i++){
+        stream[i] = list.words[((long)rand() * (RAND_MAX + 1L) + rand()) % list.count];
+    }
+
+    const int batches[] = {1, 4, 16, 64, 256};
+    const int nbatches = sizeof(batches) / sizeof(batches[0]);
+    long check = 0;
+    cout << "Lookup microbenchmark: " << n << " random words of " << list.count << " x " << LOOKUP_ROUNDS
+         << " rounds (ns/word)" << endl;
+    double single = 0;
+    for(int r = 0; r < LOOKUP_ROUNDS; r++){
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for(int i = 0; i < n; i++){
+            Postings* postings = trie->find((char*)stream[i], 0, strlen(stream[i]));
+            check += postings->get_count() + postings->get_tfs()[0];
+        }
+        single += elapsed_ns(start);
+    }
+    cout << "find      " << fixed << setprecision(1) << single / LOOKUP_ROUNDS / n << endl;
+    for(int b = 0; b < nbatches; b++){
+        double t = 0;
+        for(int r = 0; r < LOOKUP_ROUNDS; r++){
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            for(int i = 0; i < n; i += batches[b]){
+                int len = n - i < batches[b] ? n - i : batches[b];
+                trie->lookup(stream + i, len, found + i);
+                for(int j = i; j < i + len; j++){
+                    check += found[j]->get_count() + found[j]->get_tfs()[0];
+                }
+            }
+            t += elapsed_ns(start);
+        }
+        cout << "lookup " << left << setw(4) << batches[b] << right << " " << t / LOOKUP_ROUNDS / n
+             << " (" << setprecision(2) << single / t << "x)" << setprecision(1) << endl;
+    }
+    cout.unsetf(ios::fixed);
+    cout << setprecision(6);
+    if(check == -1){
+        cout << check << endl;  // keep the lookups alive
+    }
+
+    for(int i = 0; i < list.count; i++){
+        free(list.words[i]);
+    }
+    free(list.words);
+    free(stream);
+    free(found);
+}
+
+struct CountList
+{
+    int *counts;
+    int count;
+    int capacity;
+};
+
+static void collect_count(const char*, Postings* postings, void* arg)
+{
+    CountList* list = (CountList*)arg;
+    if(list->count == list->capacity){
+        list->capacity = list->capacity > 0 ? 2 * list->capacity : 1024;
+        list->counts = (int*)realloc(list->counts, list->capacity*sizeof(int));
+    }
+    list->counts[list->count++] = postings->get_count();
+}
+
+// Answers adjacent word pairs sampled from the documents (so a pair comes
+// up as often as it occurs) by intersecting the two words' lists and
+// checking the text, and with the bigram index. Then prints what smaller
+// indexes, keeping only pairs in at least T documents, would cost and
+// save. Usage: /bench phrase
+static void bench_phrase(Snapshot* snapshot)
+{
+    Mymap* map = snapshot->get_map();
+    TrieNode* trie = snapshot->get_trie();
+    BigramIndex* bigrams = snapshot->get_bigrams();
+    int N = map->get_size();
+    char** words = (char**)malloc(2*BENCH_PHRASES*sizeof(char*));
+    int n = sample_pairs(map, BENCH_PHRASES, words);
+    if(n == 0){
+        cout << "No two-word phrases in the documents" << endl;
+        free(words);
+        return;
+    }
+
+    double* scan = (double*)malloc(n*sizeof(double));
+    double* indexed = (double*)malloc(n*sizeof(double));
+    int* pairdf = (int*)malloc(n*sizeof(int));
+    Bitmap docs(N);
+    long checked = 0, check = 0;
+    // One untimed pass so both timed passes start from warm caches;
+    // each method then runs over all phrases in a pass of its own
+    for(int pass = 0; pass < 3; pass++){
+        for(int i = 0; i < n; i++){
+            const char* phrase[2] = {words[2*i], words[2*i + 1]};
+            int used;
+            BigramIndex* index = pass == 2 ? bigrams : NULL;
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            docs.fill();
+            long documents = phrase_documents(phrase, 2, trie, index, map, &docs, &used);
+            double t = elapsed_ns(start);
+            if(pass == 1){
+                scan[i] = t;
+                checked += documents;
+                check += docs.cardinality();
+            } else if(pass == 2){
+                indexed[i] = t;
+                check -= docs.cardinality();
+                Postings* pair = bigrams != NULL ? bigrams->find(phrase[0], phrase[1]) : NULL;
+                pairdf[i] = pair != NULL ? pair->get_count() : 0;
+            }
+        }
+    }
+    if(check != 0){
+        cout << "Warning: the bigram index and the text disagree" << endl;
+    }
+
+    double scanTotal = 0, indexedTotal = 0;
+    int hits = 0;
+    for(int i = 0; i < n; i++){
+        scanTotal += scan[i];
+        indexedTotal += indexed[i];
+        hits += pairdf[i] > 0;
+    }
+    cout << "Phrase microbenchmark: " << n << " two-word phrases sampled from the documents (us/phrase)" << endl;
+    cout << fixed << setprecision(1);
+    cout << "word lists + text check  " << scanTotal / n / 1000 << " (" << (double)checked / n
+         << " documents checked per phrase)" << endl;
+    if(bigrams == NULL){
+        cout << "No bigram index; start with -bigrams <n> or -bigrams list:<file> to compare" << endl;
+    } else {
+        cout << "bigram index             " << indexedTotal / n / 1000 << " (" << 100.0 * hits / n
+             << "% of phrases answered from it)" << endl;
+
+        // Smaller indexes: pairs in at least T documents
+        CountList list = {NULL, 0, 0};
+        char* buffer = (char*)malloc((map->get_buffersize() + 2)*sizeof(char));
+        bigrams->get_pairs()->visit(buffer, 0, collect_count, &list);
+        free(buffer);
+        const int thresholds[] = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000};
+        const int nthresholds = sizeof(thresholds) / sizeof(thresholds[0]);
+        cout << "min docs   pairs      bytes  answered  us/phrase" << endl;
+        for(int t = 0; t < nthresholds; t++){
+            long pairs = 0, postings = 0;
+            for(int i = 0; i < list.count; i++){
+                if(list.counts[i] >= thresholds[t]){
+                    pairs++;
+                    postings += list.counts[i];
+                }
+            }
+            if(pairs == 0)
+                break;
+            int answered = 0;
+            double total = 0;
+            for(int i = 0; i < n; i++){
+                int covered = pairdf[i] >= thresholds[t];
+                answered += covered;
+                total += covered ? indexed[i] : scan[i];
+            }
+            cout << setw(8) << thresholds[t] << setw(8) << pairs << setw(11) << postings * (long)(2 * sizeof(int))
+                 << setw(9) << 100.0 * answered / n << "%" << setw(11) << total / n / 1000 << endl;
+        }
+        free(list.counts);
+    }
+    cout.unsetf(ios::fixed);
+    cout << setprecision(6);
+
+    for(int i = 0; i < 2*n; i++){
+        free(words[i]);
+    }
+    free(words);
+    free(scan);
+    free(indexed);
+    free(pairdf);
+}
+
+// Ids of the hits left in heap, emptying it
+static int drain_ids(Maxheap* heap, int* ids)
+{
+    int n = 0;
+    while(heap->get_count() > 0){
+        ids[n++] = heap->get_id();
+        heap->remove();
+    }
+    return n;
+}
+
+int sample_queries(Mymap* map, int count, char** words, int* nwords)
+{
+    int N = map->get_size();
+    char* text = (char*)malloc((map->get_buffersize() + 1)*sizeof(char));
+    char* tokens[PLAN_MAX_TERMS * 10];
+    int n = 0;
+    srand(42);
+    for(int tries = 0; n < count && tries < 20 * count && N > 0; tries++){
+        strcpy(text, map->getDocument(map->internal_id((int)random_below(N))));
+        char* rest;
+        int ntokens = 0;
+        for(char* token = strtok_r(text, " \t", &rest); token != NULL && ntokens < PLAN_MAX_TERMS * 10;
+            token = strtok_r(NULL, " \t", &rest))
+            tokens[ntokens++] = token;
+        if(ntokens < 2)
+            continue;
+        int want = 2 + rand() % 3;
+        if(want > ntokens)
+            want = ntokens;
+        for(int w = 0; w < want; w++){
+            int pick = w + (int)random_below(ntokens - w);  // partial shuffle: distinct positions
+            char* swap = tokens[w];
+            tokens[w] = tokens[pick];
+            tokens[pick] = swap;
+            words[4*n + w] = strdup(tokens[w]);
+        }
+        nwords[n++] = want;
+    }
+    free(text);
+    return n;
+}
+
+int sample_pairs(Mymap* map, int count, char** words)
+{
+    int N = map->get_size();
+    char* text = (char*)malloc((map->get_buffersize() + 1)*sizeof(char));
+    int n = 0;
+    srand(42);
+    for(int tries = 0; n < count && tries < 20 * count && N > 0; tries++){
+        const char* document = map->getDocument((int)random_below(N));
+        strcpy(text, document);
+        char* tokens[2] = {NULL, NULL};
+        char* rest;
+        int ntokens = 0;
+        for(char* token = strtok_r(text, " \t", &rest); token != NULL; token = strtok_r(NULL, " \t", &rest))
+            ntokens++;
+        if(ntokens < 2)
+            continue;
+        // Pick one adjacent pair and tokenize again up to it
+        int at = (int)random_below(ntokens - 1);
+        strcpy(text, document);
+        char* token = strtok_r(text, " \t", &rest);
+        for(int w = 0; w <= at + 1; w++, token = strtok_r(NULL, " \t", &rest)){
+            if(w >= at)
+                tokens[w - at] = token;
+        }
+        words[2*n] = strdup(tokens[0]);
+        words[2*n + 1] = strdup(tokens[1]);
+        n++;
+    }
+    free(text);
+    return n;
+}
+
+void free_queries(char** words, int* nwords, int n)
+{
+    for(int q = 0; q < n; q++){
+        for(int w = 0; w < nwords[q]; w++){
+            free(words[4*q + w]);
+        }
+    }
+    free(words);
+    free(nwords);
+}
+
+// Runs sampled queries with the dense plan and with score-at-a-time over
+// the impact lists, and prints the time, postings scored (and skipped by
+// early termination) and recall of each. Usage: /bench impact
+static void bench_impact(Snapshot* snapshot)
+{
+    if(!snapshot->uses_impacts()){
+        cout << "Impact-ordered postings are off. Start with -impact full|global:<t>|term:<f>" << endl;
+        return;
+    }
+    char** words = (char**)malloc(4*BENCH_QUERIES*sizeof(char*));
+    int* nwords = (int*)malloc(BENCH_QUERIES*sizeof(int));
+    int n = sample_queries(snapshot->get_map(), BENCH_QUERIES, words, nwords);
+
+    const int ks[] = {10, 100};
+    cout << "Impact microbenchmark: " << n << " queries of 2-4 words sampled from the documents" << endl;
+    cout << "   k  queries   dense us  impact us   dense postings  impact postings  skipped  recall" << endl;
+    int* exactIds = (int*)malloc(ks[1]*sizeof(int));
+    int* fastIds = (int*)malloc(ks[1]*sizeof(int));
+    for(int kk = 0; kk < 2; kk++){
+        int k = ks[kk];
+        Maxheap heap(k);
+        double times[2] = {0, 0};
+        long postings[2] = {0, 0};
+        long hits = 0, total = 0;
+        int used = 0;
+        for(int q = 0; q < n; q++){
+            QueryPlan plan;
+            plan_words(&plan, (const char* const*)&words[4*q], nwords[q], snapshot, k, FIRST_PAGE);
+            if(plan.estimates[PLAN_IMPACT] < 0){
+                release_plan(&plan);
+                continue;  // no positive-IDF word: the impact lists are not used
+            }
+            used++;
+            EvalCounters counters;
+            int nexact = 0;
+            // One untimed run of each, then a timed one
+            for(int pass = 0; pass < 4; pass++){
+                plan.strategy = pass % 2 == 0 ? PLAN_DENSE : PLAN_IMPACT;
+                heap.clear();
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                run_query(&plan, snapshot, k, &heap, &counters);
+                double t = elapsed_ns(start);
+                if(pass < 2)
+                    continue;
+                times[pass - 2] += t;
+                postings[pass - 2] += counters.scored;
+                if(pass == 2){
+                    nexact = drain_ids(&heap, exactIds);
+                } else {
+                    int nfast = drain_ids(&heap, fastIds);
+                    for(int i = 0; i < nfast; i++){
+                        for(int j = 0; j < nexact; j++){
+                            if(fastIds[i] == exactIds[j]){
+                                hits++;
+                                break;
+                            }
+                        }
+                    }
+                    total += nexact;
+                }
+            }
+            release_plan(&plan);
+        }
+        if(used == 0){
+            cout << setw(4) << k << "  no query with a positive-IDF word" << endl;
+            continue;
+        }
+        cout << fixed << setprecision(1) << setw(4) << k << setw(9) << used << setw(11) << times[0] / used / 1000
+             << setw(11) << times[1] / used / 1000 << setw(17) << postings[0] << setw(17) << postings[1]
+             << setw(8) << 100.0 * (postings[0] - postings[1]) / (postings[0] > 0 ? postings[0] : 1) << "%"
+             << setw(8) << setprecision(3) << (total > 0 ? (double)hits / total : 1.0) << endl;
+        cout.unsetf(ios::fixed);
+        cout << setprecision(6);
+    }
+    free(exactIds);
+    free(fastIds);
+    free_queries(words, nwords, n);
+}
+
+// Runs sampled queries with the conjunctive plan and prints the time,
+// postings scored and skip probes per query, separately for queries led
+// by a list and by a bitmap (whose AND does not depend on docid order).
+// Queries where conjunctive falls back to wand are left out. Compare a
+// run with -reorder bp against one without. Usage: /bench intersect
+static void bench_intersect(Snapshot* snapshot, int k)
+{
+    char** words = (char**)malloc(4*BENCH_QUERIES*sizeof(char*));
+    int* nwords = (int*)malloc(BENCH_QUERIES*sizeof(int));
+    int n = sample_queries(snapshot->get_map(), BENCH_QUERIES, words, nwords);
+    Maxheap heap(k);
+    double time[2] = {0, 0};
+    long scored[2] = {0, 0}, probes[2] = {0, 0};
+    int used[2] = {0, 0}, fallbacks = 0;
+    for(int q = 0; q < n; q++){
+        QueryPlan plan;
+        plan_words(&plan, (const char* const*)&words[4*q], nwords[q], snapshot, k, FIRST_PAGE);
+        if(plan.nkept < 2){
+            release_plan(&plan);
+            continue;  // nothing to intersect
+        }
+        plan.strategy = PLAN_CONJUNCTIVE;
+        int lead = plan.terms[plan.order[0]].body->get_bitmap() != NULL;
+        EvalCounters counters;
+        double best = HUGE_VAL;
+        PlanStrategy ran = PLAN_CONJUNCTIVE;
+        for(int pass = 0; pass < INTERSECT_ROUNDS; pass++){  // fastest run counts
+            heap.clear();
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            ran = run_query(&plan, snapshot, k, &heap, &counters);
+            double t = elapsed_ns(start);
+            if(t < best)
+                best = t;
+        }
+        release_plan(&plan);
+        if(ran != PLAN_CONJUNCTIVE){
+            fallbacks++;
+            continue;
+        }
+        used[lead]++;
+        time[lead] += best;
+        scored[lead] += counters.scored;
+        probes[lead] += counters.probes;
+    }
+    free_queries(words, nwords, n);
+    cout << "Intersection microbenchmark: " << n << " queries of 2-4 words sampled from the documents, "
+         << fallbacks << " fell back to wand" << endl;
+    cout << "lead     queries   us/query   postings     probes" << endl;
+    cout << fixed << setprecision(1);
+    const char* names[2] = {"list", "bitmap"};
+    for(int lead = 0; lead < 2; lead++){
+        int u = used[lead] > 0 ? used[lead] : 1;
+        cout << left << setw(8) << names[lead] << right << setw(8) << used[lead] << setw(11) << time[lead] / u / 1000
+             << setw(11) << (double)scored[lead] / u << setw(11) << (double)probes[lead] / u << endl;
+    }
+    cout.unsetf(ios::fixed);
+    cout << setprecision(6);
+}
+
+void bench(char*, Snapshot* snapshot, int k)
+{
+    char *what = strtok(NULL, " \t\n");
+    if(what == NULL || !strcmp(what, "kernels")){
+        bench_kernels();
+        return;
+    }
+    if(!strcmp(what, "lookup")){
+        bench_lookup(snapshot->get_trie(), snapshot->get_map());
+        return;
+    }
+    if(!strcmp(what, "phrase")){
+        bench_phrase(snapshot);
+        return;
+    }
+    if(!strcmp(what, "impact")){
+        bench_impact(snapshot);
+        return;
+    }
+    if(!strcmp(what, "intersect")){
+        bench_intersect(snapshot, k);
+        return;
+    }
+    cout << "Unknown benchmark: " << what << ". Usage: /bench [kernels|lookup|phrase|impact|intersect]" << endl;
+}
@@ -0,0 +1,178 @@
+#include "Bitmap.hpp"
+using namespace std;
+
+const int RANK_WORDS = 8;  // words per rank directory entry (512 documents)
+
+Bitmap::Bitmap(int size) : nwords((size + 63) / 64), size(size), ranks(NULL)
+{
+    words = (uint64_t*)calloc(nwords > 0 ? nwords : 1, sizeof(uint64_t));
+}
+
+Bitmap::Bitmap(const int* ids, int count, int size) : nwords((size + 63) / 64), size(size), ranks(NULL)
+{
+    words = (uint64_t*)calloc(nwords > 0 ? nwords : 1, sizeof(uint64_t));
+    for(int i = 0; i < count; i++){
+        set(ids[i]);
+    }
+}
+
+Bitmap::~Bitmap()
+{
+    free(words);
+    free(ranks);
+}
+
+long Bitmap::bytes() const
+{
+    long total = (long)nwords * sizeof(uint64_t);
+    if(ranks != NULL)
+        total += (long)((nwords + RANK_WORDS - 1) / RANK_WORDS) * sizeof(int);
+    return total;
+}
+
+// Every document, no bits past size
+void Bitmap::fill()
+{
+    for(int w = 0; w < nwords; w++){
+        words[w] = ~(uint64_t)0;
+    }
+    if(size % 64 != 0){
+        words[nwords - 1] = ((uint64_t)1 << (size % 64)) - 1;
+    }
+}
+
+// The word-parallel loops below are plain enough for the compiler to
+// vectorize; both bitmaps must cover the same documents
+
+void Bitmap::and_with(const Bitmap& other)
+{
+    for(int w = 0; w < nwords; w++){
+        words[w] &= other.words[w];
+    }
+}
+
+void Bitmap::or_with(const Bitmap& other)
+{
+    for(int w = 0; w < nwords; w++){
+        words[w] |= other.words[w];
+    }
+}
+
+void Bitmap::andnot_with(const Bitmap& other)
+{
+    for(int w = 0; w < nwords; w++){
+        words[w] &= ~other.words[w];
+    }
+}
+
+// AND with a sorted id array: keep only the words the ids touch
+void Bitmap::and_ids(const int* ids, int count)
+{
+    int w = 0;
+    for(int i = 0; i < count; ){
+        int target = ids[i] >> 6;
+        uint64_t mask = 0;
+        while(i < count && (ids[i] >> 6) == target){
+            mask |= (uint64_t)1 << (ids[i] & 63);
+            i++;
+        }
+        while(w < target){
+            words[w++] = 0;
+        }
+        words[w++] &= mask;
+    }
+    while(w < nwords){
+        words[w++] = 0;
+    }
+}
+
+void Bitmap::andnot_ids(const int* ids, int count)
+{
+    for(int i = 0; i < count; i++){
+        words[ids[i] >> 6] &= ~((uint64_t)1 << (ids[i] & 63));
+    }
+}
+
+int Bitmap::cardinality() const
+{
+    int total = 0;
+    for(int w = 0; w < nwords; w++){
+        total += __builtin_popcountll(words[w]);
+    }
+    return total;
+}
+
+// First set bit at or after from, -1 if there is none
+int Bitmap::next(int from) const
+{
+    if(from >= size){
+        return -1;
+    }
+    int w = from >> 6;
+    uint64_t bits = words[w] & (~(uint64_t)0 << (from & 63));
+    while(bits == 0){
+        if(++w >= nwords){
+            return -1;
+        }
+        bits = words[w];
+    }
+    return (w << 6) + __builtin_ctzll(bits);
+}
+
+// Writes the set bits in ascending order to ids (room for cardinality())
+// and returns how many there are
+int Bitmap::decode(int* ids) const
+{
+    int n = 0;
+    for(int w = 0; w < nwords; w++){
+        uint64_t bits = words[w];
+        while(bits != 0){
+            ids[n++] = (w << 6) + __builtin_ctzll(bits);
+            bits &= bits - 1;
+        }
+    }
+    return n;
+}
+
+// Fills the rank directory; the bits must not change afterwards
+void Bitmap::build_ranks()
+{
+    int blocks = (nwords + RANK_WORDS - 1) / RANK_WORDS;
+    free(ranks);
+    ranks = (int*)malloc((blocks > 0 ? blocks : 1)*sizeof(int));
+    int total = 0;
+    for(int w = 0; w < nwords; w++){
+        if(w % RANK_WORDS == 0)
+            ranks[w / RANK_WORDS] = total;
+        total += __builtin_popcountll(words[w]);
+    }
+}
+
+// Number of set bits before id, i.e. the position of id among them.
+// Needs build_ranks().
+int Bitmap::rank(int id) const
+{
+    int w = id >> 6;
+    int total = ranks[w / RANK_WORDS];
+    for(int i = w - w % RANK_WORDS; i < w; i++){
+        total += __builtin_popcountll(words[i]);
+    }
+    return total + __builtin_popcountll(words[w] & (((uint64_t)1 << (id & 63)) - 1));
+}
+
+// Number of set bits in [from, to)
+int Bitmap::count(int from, int to) const
+{
+    if(from >= to)
+        return 0;
+    int first = from >> 6, last = (to - 1) >> 6;
+    uint64_t head = ~(uint64_t)0 << (from & 63);
+    uint64_t tail = ~(uint64_t)0 >> (63 - ((to - 1) & 63));
+    if(first == last)
+        return __builtin_popcountll(words[first] & head & tail);
+    int total = __builtin_popcountll(words[first] & head);
+    for(int w = first + 1; w < last; w++){
+        total += __builtin_popcountll(words[w]);
+    }
+    return total + __builtin_popcountll(words[last] & tail);
+}
@@ -0,0 +1,491 @@
+#include "Check.hpp"
+#include <sstream>
+using namespace std;
+
+const int CHECK_MAX_K = 10;          // largest page checked
+const int CHECK_REPORTS = 5;         // mismatches printed per check
+const int CORPUS_DOCUMENTS = 4000;   // generated when no file is given
+const int CORPUS_WORDS = 1500;
+const int CHECK_FORMS = 4;           // each sampled query as typed, +first, -last, after a phrase
+const int CHECK_LOOKUPS = 20000;     // words looked up per trie
+const int CHECK_BATCH = 64;          // largest lookup() batch
+
+// Hits of one run, best first
+struct CheckHits
+{
+    int n;
+    int ids[CHECK_MAX_K + CHECK_SLACK];
+    double scores[CHECK_MAX_K + CHECK_SLACK];
+};
+
+static void drain_hits(Maxheap* heap, CheckHits* hits)
+{
+    hits->n = 0;
+    while(heap->get_count() > 0){
+        hits->ids[hits->n] = heap->get_id();
+        hits->scores[hits->n] = heap->get_score();
+        hits->n++;
+        heap->remove();
+    }
+}
+
+static int same_score(double a, double b)
+{
+    return fabs(a - b) <= 1e-9 * (1 + fabs(a));
+}
+
+// Whether other is a correct top k given exact, the dense top k plus
+// CHECK_SLACK: the same number of hits, the same scores rank by rank and
+// every hit either in the exact top k or tied with its k-th score
+static int same_hits(const CheckHits* exact, const CheckHits* other, int k)
+{
+    int want = exact->n < k ? exact->n : k;
+    if(other->n != want)
+        return 0;
+    for(int i = 0; i < other->n; i++){
+        if(!same_score(exact->scores[i], other->scores[i]))
+            return 0;
+        int j = 0;
+        while(j < exact->n && exact->ids[j] != other->ids[i])
+            j++;
+        if(j == exact->n)
+            return 0;
+        if(j >= want && !same_score(exact->scores[j], exact->scores[want - 1]))
+            return 0;
+    }
+    return 1;
+}
+
+static void print_query(const char* const* words, int nwords)
+{
+    for(int w = 0; w < nwords; w++){
+        cout << (w > 0 ? " " : "") << words[w];
+    }
+}
+
+// Runs every applicable strategy of the query and compares it with
+// dense, on the page after the given hit. *next (if not NULL) is set to
+// the k-th dense hit, or an id of -1 when there is no next page.
+static long check_query(const char* const* words, int nwords, Snapshot* snapshot, int k, SearchAfter after,
+                        SearchAfter* next, long* compared, long* reported)
+{
+    QueryPlan plan;
+    plan_words(&plan, words, nwords, snapshot, k, after);
+    Maxheap exactHeap(k + CHECK_SLACK), heap(k);
+    CheckHits exact, other;
+    EvalCounters counters;
+    plan.strategy = PLAN_DENSE;
+    run_query(&plan, snapshot, k + CHECK_SLACK, &exactHeap, &counters);
+    drain_hits(&exactHeap, &exact);
+    if(next != NULL){
+        next->id = exact.n > k ? exact.ids[k - 1] : -1;
+        next->score = exact.n > k ? exact.scores[k - 1] : 0;
+    }
+    long mismatches = 0;
+    for(int s = 0; s < PLAN_STRATEGIES; s++){
+        if(s == PLAN_DENSE || plan.estimates[s] < 0)
+            continue;
+        plan.strategy = (PlanStrategy)s;
+        compared[s]++;
+        heap.clear();
+        run_query(&plan, snapshot, k, &heap, &counters);
+        drain_hits(&heap, &other);
+        if(same_hits(&exact, &other, k))
+            continue;
+        mismatches++;
+        if((*reported)++ < CHECK_REPORTS){
+            cout << "  " << strategy_name((PlanStrategy)s) << " differs from dense for \"";
+            print_query(words, nwords);
+            cout << "\", k " << k << (after.id >= 0 ? ", page 2" : "") << ":";
+            for(int i = 0; i < other.n; i++){
+                cout << " " << other.ids[i];
+            }
+            cout << " instead of";
+            for(int i = 0; i < exact.n && i < k; i++){
+                cout << " " << exact.ids[i];
+            }
+            cout << endl;
+        }
+    }
+    release_plan(&plan);
+    return mismatches;
+}
+
+long check_strategies(Snapshot* snapshot)
+{
+    char** words = (char**)malloc(4*CHECK_QUERIES*sizeof(char*));
+    int* nwords = (int*)malloc(CHECK_QUERIES*sizeof(int));
+    int n = sample_queries(snapshot->get_map(), CHECK_QUERIES, words, nwords);
+    const int ks[] = {1, CHECK_MAX_K};
+    long mismatches = 0, reported = 0, queries = 0;
+    long compared[PLAN_STRATEGIES] = {0};
+    char** pairs = (char**)malloc(2*CHECK_QUERIES*sizeof(char*));
+    int npairs = sample_pairs(snapshot->get_map(), CHECK_QUERIES, pairs);
+    for(int q = 0; q < n; q++){
+        // As sampled, with +first, with -last and with an adjacent pair
+        // of some document as a phrase before the first word
+        const char* const* sampled = (const char* const*)&words[4*q];
+        char required[PLAN_WORD_LENGTH + 1], excluded[PLAN_WORD_LENGTH + 1];
+        char open[PLAN_WORD_LENGTH + 1], close[PLAN_WORD_LENGTH + 1];
+        snprintf(required, sizeof(required), "+%s", sampled[0]);
+        snprintf(excluded, sizeof(excluded), "-%s", sampled[nwords[q] - 1]);
+        if(q < npairs){
+            snprintf(open, sizeof(open), "\"%s", pairs[2*q]);
+            snprintf(close, sizeof(close), "%s\"", pairs[2*q + 1]);
+        }
+        const char* forms[CHECK_FORMS][4];
+        int formwords[CHECK_FORMS];
+        int nforms = 0;
+        for(int f = 0; f < CHECK_FORMS; f++){
+            if(f == 3 && q >= npairs)
+                continue;
+            for(int w = 0; w < nwords[q]; w++){
+                forms[nforms][w] = sampled[w];
+            }
+            formwords[nforms] = nwords[q];
+            if(f == 1)
+                forms[nforms][0] = required;
+            if(f == 2)
+                forms[nforms][nwords[q] - 1] = excluded;
+            if(f == 3){
+                forms[nforms][0] = open;
+                forms[nforms][1] = close;
+                forms[nforms][2] = sampled[0];
+                formwords[nforms] = 3;
+            }
+            nforms++;
+        }
+        for(int f = 0; f < nforms; f++){
+            for(int kk = 0; kk < 2; kk++){
+                // Page 1, then the page after its k-th dense hit
+                SearchAfter next;
+                mismatches += check_query(forms[f], formwords[f], snapshot, ks[kk], FIRST_PAGE, &next, compared,
+                                          &reported);
+                queries++;
+                if(next.id < 0)
+                    continue;
+                mismatches += check_query(forms[f], formwords[f], snapshot, ks[kk], next, NULL, compared, &reported);
+                queries++;
+            }
+        }
+    }
+    free_queries(words, nwords, n);
+    for(int i = 0; i < 2*npairs; i++){
+        free(pairs[i]);
+    }
+    free(pairs);
+    cout << "  strategies: " << queries << " queries (" << n << " sampled, as typed, +first, -last and after a "
+         << "phrase; k 1 and "
+         << CHECK_MAX_K << "; pages 1 and 2), compared with dense:";
+    for(int s = 0; s < PLAN_STRATEGIES; s++){
+        if(compared[s] > 0)
+            cout << " " << strategy_name((PlanStrategy)s) << " " << compared[s];
+    }
+    cout << "; " << mismatches << " mismatch(es)" << endl;
+    return mismatches;
+}
+
+// Adjacent pairs of the documents answered from the bigram index
+// against the text check alone
+static long check_phrases(Snapshot* snapshot)
+{
+    Mymap* map = snapshot->get_map();
+    int N = map->get_size();
+    char** pairs = (char**)malloc(2*CHECK_QUERIES*sizeof(char*));
+    int n = sample_pairs(map, CHECK_QUERIES, pairs);
+    Bitmap indexed(N), scanned(N), differ(N);
+    long mismatches = 0, reported = 0, answered = 0;
+    for(int p = 0; p < n; p++){
+        const char* phrase[2] = {pairs[2*p], pairs[2*p + 1]};
+        int used;
+        indexed.fill();
+        phrase_documents(phrase, 2, snapshot->get_trie(), snapshot->get_bigrams(), map, &indexed, &used);
+        answered += used;
+        scanned.fill();
+        phrase_documents(phrase, 2, snapshot->get_trie(), NULL, map, &scanned, &used);
+        differ.fill();
+        differ.and_with(indexed);
+        differ.andnot_with(scanned);
+        int extra = differ.cardinality();
+        if(extra == 0 && indexed.cardinality() == scanned.cardinality())
+            continue;
+        mismatches++;
+        if(reported++ < CHECK_REPORTS){
+            cout << "  phrase \"" << phrase[0] << " " << phrase[1] << "\": " << indexed.cardinality()
+                 << " document(s) from the bigram index, " << scanned.cardinality() << " from the text" << endl;
+        }
+    }
+    cout << "  phrases: " << n << " adjacent pairs (" << answered << " from the bigram index) against the text: "
+         << mismatches << " mismatch(es)" << endl;
+    for(int i = 0; i < 2*n; i++){
+        free(pairs[i]);
+    }
+    free(pairs);
+    return mismatches;
+}
+
+// Words of one index looked up in another, for check_postings()
+struct PostingsCompare
+{
+    TrieNode* other;
+    int* ids;       // room to decode a bitmap word of either
+    int* otherids;
+    long words;
+    long mismatches;
+    long* reported;
+};
+
+static void compare_word(const char* word, Postings* postings, void* arg)
+{
+    PostingsCompare* compare = (PostingsCompare*)arg;
+    compare->words++;
+    Postings* other = compare->other->find((char*)word, 0, strlen(word));
+    int same = other != NULL && other->get_count() == postings->get_count();
+    const int* ids = same ? postings->decode_ids(compare->ids) : NULL;
+    const int* otherids = same ? other->decode_ids(compare->otherids) : NULL;
+    for(int i = 0; same && i < postings->get_count(); i++){
+        same = otherids[i] == ids[i] && other->get_tfs()[i] == postings->get_tfs()[i];
+    }
+    if(same)
+        return;
+    compare->mismatches++;
+    if((*compare->reported)++ < CHECK_REPORTS){
+        cout << "  postings of \"" << word << "\" differ (df " << postings->get_count() << " instead of "
+             << (other != NULL ? other->get_count() : 0) << ")" << endl;
+    }
+}
+
+static void count_word(const char*, Postings*, void* arg)
+{
+    (*(long*)arg)++;
+}
+
+// Every word of plain against the same word of other, and the number of
+// words of both
+static long check_postings(TrieNode* plain, TrieNode* other, Mymap* map, const char* what)
+{
+    if(plain == NULL || other == NULL)
+        return plain != other;
+    long reported = 0, otherwords = 0;
+    int N = map->get_size() > 0 ? map->get_size() : 1;
+    PostingsCompare compare = {other, (int*)malloc(N*sizeof(int)), (int*)malloc(N*sizeof(int)), 0, 0, &reported};
+    char* buffer = (char*)malloc((map->get_buffersize() + 2)*sizeof(char));
+    plain->visit(buffer, 0, compare_word, &compare);
+    other->visit(buffer, 0, count_word, &otherwords);
+    free(buffer);
+    free(compare.ids);
+    free(compare.otherids);
+    if(otherwords != compare.words){
+        compare.mismatches++;
+        cout << "  " << otherwords << " " << what << " words instead of " << compare.words << endl;
+    }
+    cout << "  " << what << " postings: " << compare.words << " words, " << compare.mismatches << " mismatch(es)"
+         << endl;
+    return compare.mismatches;
+}
+
+// Builds path with the options snapshot_init() was given, log silenced
+static Snapshot* build_quietly(const char* path)
+{
+    ostringstream log;  // build messages are not part of the report
+    set_build_log(&log);
+    Snapshot* snapshot = build_snapshot(path);
+    set_build_log(NULL);
+    if(snapshot == NULL)
+        cout << log.str() << "  index could not be built" << endl;
+    return snapshot;
+}
+
+// A batched build against the in-memory build of the same file, word by
+// word in every index it has
+static long check_batched(const char* path, IndexOptions options, Snapshot* batched)
+{
+    options.batch_memory = 0;
+    snapshot_init(options);
+    Snapshot* plain = build_quietly(path);
+    if(plain == NULL)
+        return 1;
+    Mymap* map = plain->get_map();
+    long mismatches = check_postings(plain->get_trie(), batched->get_trie(), map, "body");
+    if(plain->get_titles() != NULL || batched->get_titles() != NULL)
+        mismatches += check_postings(plain->get_titles(), batched->get_titles(), map, "title");
+    delete plain;
+    return mismatches;
+}
+
+// Writes documents of Zipf-distributed words, a third of them with a
+// title, so every strategy has something to do
+static int write_corpus(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if(file == NULL){
+        cout << "Cannot write " << path << endl;
+        return -1;
+    }
+    srand(11);
+    for(int d = 0; d < CORPUS_DOCUMENTS; d++){
+        int titled = rand() % 3 == 0;
+        int length = 3 + rand() % 40;
+        for(int w = 0; w < length; w++){
+            double u = (double)rand() / RAND_MAX;
+            int word = (int)pow((double)CORPUS_WORDS, u) - 1;
+            const char* separator = w == 0 ? "" : " ";
+            if(titled && w == 1 + d % 3)
+                separator = "\t";
+            fprintf(file, "%sw%d", separator, word);
+        }
+        fprintf(file, "\n");
+    }
+    fclose(file);
+    return 0;
+}
+
+// Index options checked on top of the plain index of every scorer
+struct CheckConfig
+{
+    const char* name;
+    IndexOptions options;
+};
+
+struct CheckWords
+{
+    char** words;
+    int count;
+    int capacity;
+};
+
+static void collect_word(const char* word, Postings*, void* arg)
+{
+    CheckWords* list = (CheckWords*)arg;
+    if(list->count == list->capacity){
+        list->capacity = list->capacity > 0 ? 2 * list->capacity : 1024;
+        list->words = (char**)realloc(list->words, list->capacity*sizeof(char*));
+    }
+    list->words[list->count] = (char*)malloc(strlen(word) + 1);
+    strcpy(list->words[list->count], word);
+    list->count++;
+}
+
+// Random words of the trie looked up in batches of 1 to CHECK_BATCH
+// with lookup() against find() one by one. A quarter of them get a "~"
+// appended (not indexed) and a quarter lose their last letter (a prefix
+// of an indexed word, indexed or not).
+static long check_lookup(TrieNode* trie, Mymap* map, const char* what)
+{
+    if(trie == NULL)
+        return 0;
+    CheckWords list = {NULL, 0, 0};
+    char* buffer = (char*)malloc((map->get_buffersize() + 2)*sizeof(char));
+    trie->visit(buffer, 0, collect_word, &list);
+    free(buffer);
+    if(list.count == 0)
+        return 0;
+    char** stream = (char**)malloc(CHECK_LOOKUPS*sizeof(char*));
+    Postings* found[CHECK_BATCH];
+    srand(11);
+    for(int i = 0; i < CHECK_LOOKUPS; i++){
+        const char* word = list.words[rand() % list.count];
+        size_t length = strlen(word);
+        stream[i] = (char*)malloc(length + 2);
+        strcpy(stream[i], word);
+        int form = rand() % 4;
+        if(form == 0){
+            strcat(stream[i], "~");
+        } else if(form == 1 && length > 1){
+            stream[i][length - 1] = '\0';
+        }
+    }
+    long mismatches = 0, reported = 0;
+    for(int i = 0; i < CHECK_LOOKUPS; ){
+        int len = 1 + rand() % CHECK_BATCH;
+        if(len > CHECK_LOOKUPS - i)
+            len = CHECK_LOOKUPS - i;
+        trie->lookup(stream + i, len, found);
+        for(int j = 0; j < len; j++){
+            if(found[j] == trie->find(stream[i + j], 0, strlen(stream[i + j])))
+                continue;
+            mismatches++;
+            if(reported++ < CHECK_REPORTS){
+                cout << "  lookup of \"" << stream[i + j] << "\" in " << what << " differs from find()" << endl;
+            }
+        }
+        i += len;
+    }
+    cout << "  lookup: " << CHECK_LOOKUPS << " " << what << " words (a quarter with \"~\", a quarter cut short)"
+         << " in batches of 1-" << CHECK_BATCH << " against find(): " << mismatches << " mismatch(es)" << endl;
+    for(int i = 0; i < CHECK_LOOKUPS; i++){
+        free(stream[i]);
+    }
+    free(stream);
+    for(int i = 0; i < list.count; i++){
+        free(list.words[i]);
+    }
+    free(list.words);
+    return mismatches;
+}
+
+// Builds path with options and runs every check on it. A batched build
+// is compared with the in-memory one first.
+static long check_index(const char* path, const char* name, IndexOptions options)
+{
+    cout << name << endl;
+    snapshot_init(options);
+    search_init(options.scorer, options.params);
+    Snapshot* snapshot = build_quietly(path);
+    if(snapshot == NULL)
+        return 1;
+    long mismatches = 0;
+    if(options.batch_memory > 0)
+        mismatches += check_batched(path, options, snapshot);
+    mismatches += check_lookup(snapshot->get_trie(), snapshot->get_map(), "body");
+    mismatches += check_lookup(snapshot->get_titles(), snapshot->get_map(), "title");
+    if(snapshot->get_bigrams() != NULL)
+        mismatches += check_phrases(snapshot);
+    mismatches += check_strategies(snapshot);
+    delete snapshot;
+    return mismatches;
+}
+
+// searchengine_check [file]: indexes file (a generated one by default)
+// with every scorer and checks the fast paths against their plain
+// versions. Exits 1 on a mismatch.
+int main(int argc, char** argv)
+{
+    const char* path = "check_corpus.txt";
+    if(argc > 2){
+        cout << "Usage: searchengine_check [file]" << endl;
+        return -1;
+    }
+    if(argc == 2){
+        path = argv[1];
+    } else if(write_corpus(path) == -1){
+        return -1;
+    }
+
+    long mismatches = 0;
+    const ScorerType scorers[] = {SCORER_BM25, SCORER_BM25PLUS, SCORER_TFIDF, SCORER_BM25F};
+    for(int s = 0; s < 4; s++){
+        IndexOptions options = {scorers[s], {1.2f, 0.75f}, {IMPACT_OFF, 0}, REORDER_NONE, 0, {BIGRAMS_OFF, 0, NULL}};
+        mismatches += check_index(path, scorer_name(scorers[s]), options);
+    }
+    const CheckConfig configs[] = {
+        {"bm25, -impact full", {SCORER_BM25, {1.2f, 0.75f}, {IMPACT_FULL, 0}, REORDER_NONE, 0, {BIGRAMS_OFF, 0, NULL}}},
+        {"bm25f, -impact full", {SCORER_BM25F, {1.2f, 0.75f}, {IMPACT_FULL, 0}, REORDER_NONE, 0, {BIGRAMS_OFF, 0, NULL}}},
+        {"bm25f, -batch-memory in 64 KB batches", {SCORER_BM25F, {1.2f, 0.75f}, {IMPACT_OFF, 0}, REORDER_NONE, 64 * 1024,
+                                                   {BIGRAMS_OFF, 0, NULL}}},
+        {"bm25, -reorder bp", {SCORER_BM25, {1.2f, 0.75f}, {IMPACT_OFF, 0}, REORDER_BP, 0, {BIGRAMS_OFF, 0, NULL}}},
+        {"bm25, -bigrams 2", {SCORER_BM25, {1.2f, 0.75f}, {IMPACT_OFF, 0}, REORDER_NONE, 0, {BIGRAMS_FREQUENT, 2, NULL}}},
+    };
+    for(int c = 0; c < (int)(sizeof(configs) / sizeof(configs[0])); c++){
+        mismatches += check_index(path, configs[c].name, configs[c].options);
+    }
+
+    cout << "kernels" << endl;
+    for(int level = KERNEL_SSE4; level <= kernel_detect(); level++){
+        long wrong = check_kernels((KernelLevel)level);
+        cout << "  " << kernel_name((KernelLevel)level) << " vs scalar: " << wrong << " mismatch(es)" << endl;
+        mismatches += wrong;
+    }
+    cout << (mismatches == 0 ? "All checks passed" : "Checks FAILED") << endl;
+    return mismatches == 0 ? 0 : 1;
+}
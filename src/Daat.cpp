@@ -0,0 +1,367 @@
+#include "Daat.hpp"
+#include <climits>
+using namespace std;
+
+const int SEEK_COUNT_LIMIT = 512;  // bitmap steps shorter than this count bits instead of ranking
+
+struct Cursor
+{
+    const PlanTerm* term;
+    TermContext context;
+    const int* ids;      // NULL when the word's ids are a bitmap
+    const Bitmap* bits;
+    int count;
+    int pos;             // index of doc in the list (and its tfs)
+    int doc;             // current document, INT_MAX past the end
+};
+
+// Cursors in plan order (rarest first); scores are always summed in this
+// order so every evaluator produces the same value for a document
+static void open_cursors(const QueryPlan* plan, const TermContext& base, Cursor* cursors)
+{
+    for(int i = 0; i < plan->nkept; i++){
+        const PlanTerm* term = &plan->terms[plan->order[i]];
+        Cursor* c = &cursors[i];
+        c->term = term;
+        c->context = base;
+        c->context.body = term->body;
+        c->context.title = term->title;
+        c->ids = term->body->get_ids();
+        c->bits = term->body->get_bitmap();
+        c->count = term->body->get_count();
+        c->pos = 0;
+        c->doc = c->count == 0 ? INT_MAX : c->ids != NULL ? c->ids[0] : c->bits->next(0);
+    }
+}
+
+// Steps past the current document
+static void advance(Cursor* c)
+{
+    c->pos++;
+    if(c->pos >= c->count)
+        c->doc = INT_MAX;
+    else
+        c->doc = c->ids != NULL ? c->ids[c->pos] : c->bits->next(c->doc + 1);
+}
+
+// Moves to the first document >= target. An array gallops, then binary
+// searches inside the last step; a bitmap finds the next set bit and
+// ranks it, one probe.
+static void seek(Cursor* c, int target, long* probes)
+{
+    if(c->doc >= target)
+        return;
+    if(c->bits != NULL){
+        (*probes)++;
+        int doc = c->bits->next(target);
+        if(doc == -1){
+            c->doc = INT_MAX;
+            c->pos = c->count;
+        } else {
+            // A short step counts the bits skipped, a long one ranks
+            c->pos = doc - c->doc < SEEK_COUNT_LIMIT ? c->pos + c->bits->count(c->doc, doc) : c->bits->rank(doc);
+            c->doc = doc;
+        }
+        return;
+    }
+    const int* ids = c->ids;
+    int count = c->count;
+    int low = c->pos, high = c->pos, step = 1;
+    while(high < count && ids[high] < target){
+        low = high + 1;
+        high += step;
+        step <<= 1;
+        (*probes)++;
+    }
+    if(high > count)
+        high = count;
+    while(low < high){
+        int mid = low + (high - low) / 2;
+        (*probes)++;
+        if(ids[mid] < target)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    c->pos = low;
+    c->doc = low < count ? ids[low] : INT_MAX;
+}
+
+// Sums (and steps past) every cursor positioned on doc
+template <class Scorer>
+static double score_document(Cursor* cursors, int n, int doc, EvalCounters* counters)
+{
+    double score = 0;
+    for(int i = 0; i < n; i++){
+        Cursor* c = &cursors[i];
+        if(c->doc == doc){
+            score += Scorer::score(c->context, c->term->weight, c->pos, doc);
+            advance(c);
+            counters->scored++;
+        }
+    }
+    return score;
+}
+
+// Inserts doc unless the boolean filter rules it out or it was on an
+// earlier page. Documents arrive in docid order, so one tying the k-th
+// score ranks below it and can be left out too.
+static void offer(Maxheap* heap, const QueryPlan* plan, const Bitmap* filter, double score, int doc,
+                  double* threshold)
+{
+    if(score > *threshold && (filter == NULL || filter->test(doc)) && plan_admits(plan, score, doc)){
+        heap->insert(score, doc);
+        *threshold = heap->get_min();
+    }
+}
+
+template <class Scorer>
+static void union_lists(Cursor* cursors, int n, const QueryPlan* plan, Maxheap* heap, EvalCounters* counters)
+{
+    double threshold = heap->get_min();
+    while(1){
+        int doc = INT_MAX;
+        for(int i = 0; i < n; i++){
+            if(cursors[i].doc < doc)
+                doc = cursors[i].doc;
+        }
+        if(doc == INT_MAX)
+            break;
+        double score = score_document<Scorer>(cursors, n, doc, counters);
+        offer(heap, plan, plan->filter, score, doc, &threshold);
+    }
+}
+
+// WAND: with the cursors sorted by current docid, the pivot is the first
+// one at which the summed upper bounds exceed the k-th best score. No
+// document before the pivot's can enter the top k, so the cursors in
+// front of it jump straight there.
+template <class Scorer>
+static void wand_lists(Cursor* cursors, int n, const QueryPlan* plan, Maxheap* heap, EvalCounters* counters)
+{
+    Cursor* sorted[PLAN_MAX_TERMS];
+    double threshold = heap->get_min();
+    while(1){
+        int live = 0;
+        for(int i = 0; i < n; i++){
+            Cursor* c = &cursors[i];
+            if(c->doc == INT_MAX)
+                continue;
+            int p = live++;
+            while(p > 0 && sorted[p - 1]->doc > c->doc){
+                sorted[p] = sorted[p - 1];
+                p--;
+            }
+            sorted[p] = c;
+        }
+        double bound = 0;
+        int pivot = -1;
+        for(int p = 0; p < live; p++){
+            bound += sorted[p]->term->upper;
+            if(bound > threshold){
+                pivot = p;
+                break;
+            }
+        }
+        if(pivot == -1)
+            break;  // nothing left can beat the k-th best
+        int doc = sorted[pivot]->doc;
+        if(sorted[0]->doc == doc){
+            double score = score_document<Scorer>(cursors, n, doc, counters);
+            offer(heap, plan, plan->filter, score, doc, &threshold);
+        } else {
+            for(int p = 0; p < pivot; p++){
+                seek(sorted[p], doc, &counters->probes);
+            }
+        }
+    }
+}
+
+// Visits only the documents the filter allows; every cursor skips to
+// each of them, so a short filter over long lists touches little of them
+template <class Scorer>
+static void filtered_lists(Cursor* cursors, int n, const QueryPlan* plan, Maxheap* heap, EvalCounters* counters)
+{
+    double threshold = heap->get_min();
+    const Bitmap* filter = plan->filter;
+    for(int doc = filter->next(0); doc != -1; doc = filter->next(doc + 1)){
+        int found = 0;
+        for(int i = 0; i < n; i++){
+            seek(&cursors[i], doc, &counters->probes);
+            found |= cursors[i].doc == doc;
+        }
+        if(found){
+            double score = score_document<Scorer>(cursors, n, doc, counters);
+            offer(heap, plan, NULL, score, doc, &threshold);
+        }
+    }
+}
+
+// Positions every cursor on doc (known to be in every list) and scores it
+template <class Scorer>
+static void score_common(Cursor* cursors, int n, int doc, const QueryPlan* plan, Maxheap* heap,
+                         EvalCounters* counters, double* threshold)
+{
+    for(int i = 0; i < n; i++){
+        seek(&cursors[i], doc, &counters->probes);
+    }
+    double score = score_document<Scorer>(cursors, n, doc, counters);
+    offer(heap, plan, NULL, score, doc, threshold);
+}
+
+// Intersection led by the rarest list. When the rarest word is a bitmap
+// so is every other, and the bitmaps are ANDed 64 documents at a time.
+// Otherwise the lead's documents are checked against the bitmap words
+// with one bit test each, against their AND when there are several and
+// the lead is long enough to pay for it, and the array words are skipped
+// to. Returns -1 if a document missing one of the words could still
+// outscore the k-th result.
+template <class Scorer>
+static int intersect_lists(Cursor* cursors, int n, const QueryPlan* plan, Maxheap* heap, EvalCounters* counters)
+{
+    const Bitmap* filter = plan->filter;
+    double threshold = heap->get_min();
+    const Bitmap* lead = cursors[0].bits;
+    if(lead != NULL){
+        Bitmap common(lead->get_size());
+        common.fill();
+        for(int i = 0; i < n; i++){
+            common.and_with(*cursors[i].bits);
+        }
+        if(filter != NULL){
+            common.and_with(*filter);
+        }
+        counters->probes += (long)(n + 1) * ((lead->get_size() + 511) / 512);  // one cache line per probe
+        // Word by word: every list holds each common document, so its
+        // position is where the list stands at the start of the word
+        // plus the bits below the document in it
+        int base[PLAN_MAX_TERMS];
+        for(int w = 0; w < common.get_nwords(); w++){
+            uint64_t bits = common.word(w);
+            if(bits == 0)
+                continue;
+            for(int i = 0; i < n; i++){
+                base[i] = cursors[i].bits->rank(w << 6);
+            }
+            while(bits != 0){
+                int bit = __builtin_ctzll(bits);
+                int doc = (w << 6) + bit;
+                uint64_t below = ((uint64_t)1 << bit) - 1;
+                double score = 0;
+                for(int i = 0; i < n; i++){
+                    int pos = base[i] + __builtin_popcountll(cursors[i].bits->word(w) & below);
+                    score += Scorer::score(cursors[i].context, cursors[i].term->weight, pos, doc);
+                }
+                counters->scored += n;
+                offer(heap, plan, NULL, score, doc, &threshold);
+                bits &= bits - 1;
+            }
+        }
+    } else {
+        Cursor* first = &cursors[0];
+        int nbits = 0;
+        for(int i = 1; i < n; i++){
+            nbits += cursors[i].bits != NULL;
+        }
+        Bitmap* common = NULL;  // AND of the bitmap words (and the filter)
+        if(nbits >= 2){
+            int size = 0;
+            for(int i = 1; i < n && size == 0; i++){
+                if(cursors[i].bits != NULL)
+                    size = cursors[i].bits->get_size();
+            }
+            if(first->count >= (size + 63) / 64){
+                common = new Bitmap(size);
+                common->fill();
+                for(int i = 1; i < n; i++){
+                    if(cursors[i].bits != NULL)
+                        common->and_with(*cursors[i].bits);
+                }
+                if(filter != NULL)
+                    common->and_with(*filter);
+                counters->probes += (long)(nbits + 1) * ((size + 511) / 512);
+            }
+        }
+        int done = 0;
+        while(!done && first->doc != INT_MAX){
+            int doc = first->doc;
+            int everywhere;
+            if(common != NULL){
+                counters->probes++;
+                everywhere = common->test(doc);
+            } else {
+                everywhere = filter == NULL || filter->test(doc);
+                for(int i = 1; i < n && everywhere; i++){
+                    if(cursors[i].bits != NULL){
+                        counters->probes++;
+                        everywhere = cursors[i].bits->test(doc);
+                    }
+                }
+            }
+            for(int i = 1; i < n && everywhere; i++){
+                Cursor* c = &cursors[i];
+                if(c->bits != NULL){
+                    continue;  // positioned by score_common
+                }
+                seek(c, doc, &counters->probes);
+                done = c->doc == INT_MAX;
+                everywhere = c->doc == doc;
+            }
+            if(everywhere){
+                score_common<Scorer>(cursors, n, doc, plan, heap, counters, &threshold);  // steps past doc
+            } else {
+                advance(first);
+            }
+        }
+        delete common;
+    }
+    // A document missing a +word is filtered out anyway; one missing any
+    // other word scores at most the sum of the remaining bounds
+    double total = 0, weakest = HUGE_VAL;
+    for(int i = 0; i < n; i++){
+        total += cursors[i].term->upper;
+        if(!cursors[i].term->required && cursors[i].term->upper < weakest)
+            weakest = cursors[i].term->upper;
+    }
+    if(weakest == HUGE_VAL){
+        return 1;
+    }
+    // heap->get_min() is -inf while fewer than k documents matched
+    return heap->get_min() > total - weakest ? 1 : -1;
+}
+
+template <class Scorer>
+static PlanStrategy evaluate(const QueryPlan* plan, const TermContext& base, Maxheap* heap, EvalCounters* counters)
+{
+    Cursor cursors[PLAN_MAX_TERMS];
+    open_cursors(plan, base, cursors);
+    switch(plan->strategy){
+        case PLAN_CONJUNCTIVE:
+            if(intersect_lists<Scorer>(cursors, plan->nkept, plan, heap, counters) == 1)
+                return PLAN_CONJUNCTIVE;
+            heap->clear();
+            open_cursors(plan, base, cursors);
+            wand_lists<Scorer>(cursors, plan->nkept, plan, heap, counters);
+            return PLAN_WAND;
+        case PLAN_WAND:
+            wand_lists<Scorer>(cursors, plan->nkept, plan, heap, counters);
+            return PLAN_WAND;
+        case PLAN_FILTERED:
+            filtered_lists<Scorer>(cursors, plan->nkept, plan, heap, counters);
+            return PLAN_FILTERED;
+        default:
+            union_lists<Scorer>(cursors, plan->nkept, plan, heap, counters);
+            return PLAN_DAAT;
+    }
+}
+
+PlanStrategy daat_evaluate(const QueryPlan* plan, ScorerType type, const TermContext& base,
+                           Maxheap* heap, EvalCounters* counters)
+{
+    switch(type){
+        case SCORER_BM25PLUS: return evaluate<BM25Plus>(plan, base, heap, counters);
+        case SCORER_TFIDF:    return evaluate<TfIdf>(plan, base, heap, counters);
+        case SCORER_BM25F:    return evaluate<BM25F>(plan, base, heap, counters);
+        default:              return evaluate<BM25>(plan, base, heap, counters);
+    }
+}
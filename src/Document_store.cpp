@@ -1,16 +1,23 @@
 #include "Document_store.hpp"
 using namespace std;
+static thread_local ostream* log_stream = NULL;
+ostream& build_log(){
+    return log_stream != NULL ? *log_stream : cout;
+}
+void set_build_log(ostream* log){
+    log_stream = log;
+}
 int read_sizes(int *linecounter,int *maxlength, char *file_name){
     FILE *file=fopen(file_name, "r");
     if(file==NULL){
-        cout<<"Cannot open file: "<<file_name<<endl;
+        build_log()<<"Cannot open file: "<<file_name<<endl;
         return -1;
     }
     
     // Check if file is empty
     int c = fgetc(file);
     if(c == EOF){
-        cout<<"File is empty: "<<file_name<<endl;
+        build_log()<<"File is empty: "<<file_name<<endl;
         fclose(file);
         return -1;
     }
@@ -35,45 +42,89 @@ int read_sizes(int *linecounter,int *maxlength, char *file_name){
     free(line);
     return 1;
 }
-void split(char* temp,int id,TrieNode* trie,Mymap* mymap){
+// First pass for -bigrams <n>: counts every adjacent pair of words in
+// the lines the index will hold (the first mymap->get_size()), trimmed
+// by Mymap::trim() and tokenized as split() will see them
+int count_bigrams(Mymap* mymap, char* file_name, BigramIndex* bigrams){
+    FILE *file=fopen(file_name, "r");
+    if(file==NULL){
+        build_log()<<"Cannot open file: "<<file_name<<endl;
+        return -1;
+    }
+    char *line=NULL;
+    size_t buffersize=0;
+    for(int i=0;i<mymap->get_size() && getline(&line, &buffersize, file)!=-1;i++){
+        int len;
+        char* rest;
+        char* previous=NULL;
+        char* start=Mymap::trim(line, &len);
+        for(char* token=strtok_r(start, " \t", &rest); token!=NULL; token=strtok_r(NULL, " \t", &rest)){
+            if(previous!=NULL)
+                bigrams->count(previous, token);
+            previous=token;
+        }
+    }
+    free(line);
+    fclose(file);
+    return 1;
+}
+// Returns the bytes trie, titles and the bigram pairs allocated for this
+// document
+long split(char* temp,int id,TrieNode* trie,Mymap* mymap,TrieNode* titles,BigramIndex* bigrams){
     char* token;
-    token = strtok(temp, " \t");
+    char* rest;  // strtok_r: a /reload build runs while queries use strtok
+    // Words before the first tab form the title field (used by BM25F)
+    char* tab = strchr(temp, '\t');
+    token = strtok_r(temp, " \t", &rest);
     int i=0;
+    int titlewords=0;
+    long bytes=0;
+    char* previous=NULL;
     while(token != NULL){
         
         i++;
-        trie->insert(token, id);
-        token = strtok(NULL, " \t");
+        bytes+=trie->insert(token, id);
+        if(bigrams != NULL && previous != NULL)
+            bytes+=bigrams->add(previous, token, id);
+        previous=token;
+        if(tab != NULL && token < tab){
+            titlewords++;
+            if(titles != NULL)
+                bytes+=titles->insert(token, id);
+        }
+        token = strtok_r(NULL, " \t", &rest);
     }
-    mymap->setlength(id,i);
+    mymap->setlength(i,id);
+    mymap->settitlelength(titlewords,id);
+    return bytes;
 
 }
-int read_input(Mymap* mymap,TrieNode *trie, char* file_name){
+int read_input(Mymap* mymap,TrieNode *trie, char* file_name, TrieNode* titles, BigramIndex* bigrams){
     FILE *file = fopen(file_name, "r");
     if(file == NULL){
-        cout << "Error opening file: " << file_name << endl;
+        build_log() << "Error opening file: " << file_name << endl;
         return -1;
     }
     char *line = NULL;
     size_t buffersize = 0;
-    char *temp = (char*)malloc(mymap->get_buffersize()*sizeof(char));
+    char *temp = (char*)malloc((mymap->get_buffersize()+1)*sizeof(char));
     for(int i=0;i<mymap->get_size();i++){
         if(getline(&line, &buffersize, file) == -1){
-            cout << "Error reading line " << i << endl;
+            build_log() << "Error reading line " << i << endl;
             free(line);
             fclose(file);
             free(temp);
             return -1;
         }
         if (mymap->insert(line, i) == -1) {
-            cout << "Error inserting line " << endl;
+            build_log() << "Error inserting line " << endl;
             free(line);
             fclose(file);
             free(temp);
             return -1;
         }
         strcpy(temp,mymap->getDocument(i));
-        split(temp,i,trie,mymap);
+        split(temp,i,trie,mymap,titles,bigrams);
         free(line);
         line = NULL;
         buffersize = 0;
@@ -81,5 +132,10 @@ int read_input(Mymap* mymap,TrieNode *trie, char* file_name){
     free(line);
     fclose(file);
     free(temp);
+    trie->finalize();
+    if(titles != NULL)
+        titles->finalize();
+    if(bigrams != NULL)
+        bigrams->finalize();
     return 1;
 }
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include "Filter.hpp"
+using namespace std;
+
+int parse_operators(QueryPlan* plan, const char* const* words, int nwords, int* excluded, int* quoted)
+{
+    int operators = 0;
+    int open = 0;  // inside a phrase
+    plan->nphrases = 0;
+    for(int l = 0; l < nwords; l++){
+        PlanTerm* term = &plan->terms[l];
+        const char* word = words[l];
+        excluded[l] = 0;
+        term->required = 0;
+        int literal = !open && word[0] == '\\' && word[1] != '\0';
+        if(literal){
+            word++;  // \+word, \-word, \"word, \\word: the rest as typed
+        }
+        else if(!open && (word[0] == '+' || word[0] == '-') && word[1] != '\0'){
+            term->required = word[0] == '+';
+            excluded[l] = word[0] == '-';
+            operators++;
+            word++;
+        }
+        if(!open && !literal && word[0] == '"'){
+            PlanPhrase* phrase = &plan->phrases[plan->nphrases++];
+            phrase->first = l;
+            phrase->count = 0;
+            phrase->excluded = excluded[l];
+            phrase->indexed = 0;
+            phrase->checked = 0;
+            phrase->documents = 0;
+            term->required = 0;  // the phrase is what is required
+            open = 1;
+            word++;
+        }
+        size_t length = strlen(word);
+        quoted[l] = open;
+        if(open){
+            PlanPhrase* phrase = &plan->phrases[plan->nphrases - 1];
+            excluded[l] = phrase->excluded;
+            phrase->count++;
+            if(length > 0 && word[length - 1] == '"'){
+                length--;
+                open = 0;  // a phrase left open runs to the end of the query
+            }
+        }
+        if(length >= (size_t)PLAN_WORD_LENGTH)
+            length = PLAN_WORD_LENGTH - 1;
+        memcpy(term->word, word, length);
+        term->word[length] = '\0';
+    }
+    return operators;
+}
+
+void build_filter(QueryPlan* plan, int operators, const int* quoted, TrieNode* trie, BigramIndex* bigrams,
+                  Mymap* map)
+{
+    plan->filter = NULL;
+    if(operators == 0 && plan->nphrases == 0)
+        return;
+    int N = map->get_size();
+    plan->filter = new Bitmap(N);
+    plan->filter->fill();
+    for(int l = 0; l < plan->nterms; l++){
+        const PlanTerm* term = &plan->terms[l];
+        if(quoted[l] || (!term->required && term->status != TERM_EXCLUDED))
+            continue;
+        const Bitmap* bits = term->body != NULL ? term->body->get_bitmap() : NULL;
+        const int* ids = term->body != NULL ? term->body->get_ids() : NULL;
+        if(term->required && bits != NULL)
+            plan->filter->and_with(*bits);
+        else if(term->required)
+            plan->filter->and_ids(ids, term->df);
+        else if(bits != NULL)
+            plan->filter->andnot_with(*bits);
+        else
+            plan->filter->andnot_ids(ids, term->df);
+    }
+    // Phrases to keep narrow the filter itself, so only documents
+    // still allowed get their text checked; then the ones to drop
+    for(int pass = 0; pass < 2; pass++){
+        for(int p = 0; p < plan->nphrases; p++){
+            PlanPhrase* phrase = &plan->phrases[p];
+            if(phrase->excluded != pass)
+                continue;
+            const char* phraseWords[PLAN_MAX_TERMS];
+            int n = 0;
+            for(int l = phrase->first; l < phrase->first + phrase->count; l++){
+                if(plan->terms[l].word[0] != '\0')
+                    phraseWords[n++] = plan->terms[l].word;
+            }
+            if(n == 0)
+                continue;  // ""
+            if(!phrase->excluded){
+                phrase->checked = phrase_documents(phraseWords, n, trie, bigrams, map, plan->filter,
+                                                   &phrase->indexed);
+                phrase->documents = plan->filter->cardinality();
+            } else {
+                Bitmap docs(N);
+                docs.fill();
+                docs.and_with(*plan->filter);
+                phrase->checked = phrase_documents(phraseWords, n, trie, bigrams, map, &docs, &phrase->indexed);
+                phrase->documents = docs.cardinality();
+                plan->filter->andnot_with(docs);
+            }
+        }
+    }
+}
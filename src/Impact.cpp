@@ -0,0 +1,288 @@
+#include "Impact.hpp"
+#include <cmath>
+using namespace std;
+
+const int SAAT_BLOCK = 64;     // Postings taken from one term per step
+
+int parse_impact(const char* text, ImpactOptions* options)
+{
+    char* end;
+    if(!strcmp(text, "full")){
+        options->mode = IMPACT_FULL;
+        options->value = 0;
+        return 1;
+    }
+    if(!strncmp(text, "global:", 7)){
+        options->mode = IMPACT_GLOBAL;
+        options->value = strtod(text + 7, &end);
+        return (end != text + 7 && *end == '\0') ? 1 : -1;
+    }
+    if(!strncmp(text, "term:", 5)){
+        options->mode = IMPACT_TERM;
+        options->value = strtod(text + 5, &end);
+        if(end == text + 5 || *end != '\0' || options->value <= 0 || options->value > 1)
+            return -1;
+        return 1;
+    }
+    return -1;
+}
+
+struct ImpactEntry
+{
+    double impact;
+    int id;
+};
+
+// Highest impact first, ties by docid so builds are reproducible
+static int compare_impact(const void* a, const void* b)
+{
+    const ImpactEntry* x = (const ImpactEntry*)a;
+    const ImpactEntry* y = (const ImpactEntry*)b;
+    if(x->impact != y->impact)
+        return x->impact > y->impact ? -1 : 1;
+    return x->id - y->id;
+}
+
+struct ImpactBuild
+{
+    TrieNode* titles;
+    Mymap* map;
+    ImpactOptions options;
+    TermContext context;
+    double* weights;
+    int* ids;  // room to decode a bitmap word
+    ImpactEntry* entries;
+};
+
+// Scores one term's postings with the active policy, sorts them by
+// impact and keeps the ones that survive pruning
+template <class Scorer>
+static void impact_term(const char* word, Postings* postings, void* arg)
+{
+    ImpactBuild* build = (ImpactBuild*)arg;
+    int count = postings->get_count();
+    const int* ids = postings->decode_ids(build->ids);
+    build->context.body = postings;
+    build->context.ids = ids;
+    build->context.title = NULL;
+    if(Scorer::uses_titles && build->titles != NULL){
+        build->context.title = build->titles->find((char*)word, 0, strlen(word));
+    }
+    double idf = Scorer::idf((double)build->map->get_size(), (double)count);
+    Scorer::weights(build->context, idf, build->weights);
+
+    for(int i = 0; i < count; i++){
+        build->entries[i].impact = build->weights[i];
+        build->entries[i].id = ids[i];
+    }
+    qsort(build->entries, count, sizeof(ImpactEntry), compare_impact);
+
+    int keep = count;
+    if(build->options.mode == IMPACT_TERM){
+        keep = (int)(count * build->options.value + 0.999999);
+        if(keep < 1)
+            keep = 1;
+    }
+    else if(build->options.mode == IMPACT_GLOBAL){
+        keep = 0;
+        while(keep < count && build->entries[keep].impact >= build->options.value)
+            keep++;
+    }
+    int* keptids = (int*)malloc((keep > 0 ? keep : 1)*sizeof(int));
+    double* keptimpacts = (double*)malloc((keep > 0 ? keep : 1)*sizeof(double));
+    for(int i = 0; i < keep; i++){
+        keptids[i] = build->entries[i].id;
+        keptimpacts[i] = build->entries[i].impact;
+    }
+    postings->set_impacts(keptids, keptimpacts, keep);
+}
+
+void build_impacts(TrieNode* trie, TrieNode* titles, Mymap* map, ScorerType type,
+                   ScorerParams params, ImpactOptions options)
+{
+    if(options.mode == IMPACT_OFF){
+        return;
+    }
+    int N = map->get_size() > 0 ? map->get_size() : 1;
+    ImpactBuild build;
+    build.titles = titles;
+    build.map = map;
+    build.options = options;
+    build.context.norms = map->get_norms();
+    build.context.title_norms = map->get_title_norms();
+    build.context.body_norms = map->get_body_norms();
+    build.context.params = params;
+    build.weights = (double*)malloc(N*sizeof(double));
+    build.ids = (int*)malloc(N*sizeof(int));
+    build.entries = (ImpactEntry*)malloc(N*sizeof(ImpactEntry));
+    char* buffer = (char*)malloc((map->get_buffersize() + 2)*sizeof(char));
+
+    TermVisitor visitor;
+    switch(type){
+        case SCORER_BM25PLUS: visitor = impact_term<BM25Plus>; break;
+        case SCORER_TFIDF:    visitor = impact_term<TfIdf>; break;
+        case SCORER_BM25F:    visitor = impact_term<BM25F>; break;
+        default:              visitor = impact_term<BM25>; break;
+    }
+    trie->visit(buffer, 0, visitor, &build);
+
+    free(buffer);
+    free(build.entries);
+    free(build.ids);
+    free(build.weights);
+}
+
+// Running top k+1 of the accumulators: a min-heap of docids keyed by
+// acc, with slots[d] the position of d while seen[d] == 2. Scores only
+// grow, so a document outside can join only by beating the minimum, and
+// the heap stays exactly the best k+1 seen so far.
+struct RunningTop
+{
+    int docs[SAAT_MAX_K + 1];
+    int size;
+    int capacity;
+    const double* acc;
+    char* seen;
+    int* slots;
+};
+
+static void top_place(RunningTop* top, int i, int doc)
+{
+    top->docs[i] = doc;
+    top->slots[doc] = i;
+}
+
+static void top_sift_up(RunningTop* top, int i)
+{
+    int doc = top->docs[i];
+    while(i > 0 && top->acc[top->docs[(i - 1) / 2]] > top->acc[doc]){
+        top_place(top, i, top->docs[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    top_place(top, i, doc);
+}
+
+static void top_sift_down(RunningTop* top, int i)
+{
+    int doc = top->docs[i];
+    while(1){
+        int child = 2 * i + 1;
+        if(child >= top->size)
+            break;
+        if(child + 1 < top->size && top->acc[top->docs[child + 1]] < top->acc[top->docs[child]])
+            child++;
+        if(top->acc[top->docs[child]] >= top->acc[doc])
+            break;
+        top_place(top, i, top->docs[child]);
+        i = child;
+    }
+    top_place(top, i, doc);
+}
+
+// acc[doc] has just grown
+static void top_update(RunningTop* top, int doc)
+{
+    if(top->seen[doc] == 2){
+        top_sift_down(top, top->slots[doc]);
+    } else if(top->size < top->capacity){
+        top->seen[doc] = 2;
+        top->size++;
+        top_place(top, top->size - 1, doc);
+        top_sift_up(top, top->size - 1);
+    } else if(top->acc[doc] > top->acc[top->docs[0]]){
+        top->seen[top->docs[0]] = 1;
+        top->seen[doc] = 2;
+        top_place(top, 0, doc);
+        top_sift_down(top, 0);
+    }
+}
+
+// k-th and (k+1)-th best accumulated scores so far, read off the heap
+static void top_bounds(const RunningTop* top, int k, double* kth, double* next)
+{
+    const double* acc = top->acc;
+    if(top->size <= k){
+        *kth = acc[top->docs[0]];
+        *next = 0;  // documents never seen so far start from 0
+        return;
+    }
+    double second = acc[top->docs[1]];
+    if(top->size > 2 && acc[top->docs[2]] < second)
+        second = acc[top->docs[2]];
+    *kth = second;
+    *next = acc[top->docs[0]] > 0 ? acc[top->docs[0]] : 0;
+}
+
+// Score-at-a-time: repeatedly takes a block from the term whose next
+// posting has the highest impact, keeping the best k+1 accumulators in a
+// small heap as it goes. Any document can still gain at most the sum of
+// every term's next impact, so once the k-th best score beats the
+// (k+1)-th best plus that gain the top-k set cannot change and the rest
+// of the lists is skipped; the check is O(1) and runs before every
+// block. Lists with negative impacts (a word whose IDF is not positive)
+// are read to the end. Without pruning the set is exact, but acc holds
+// the partial sums accumulated so far: run_query() scores the best k again
+// from the full postings. seen[d] becomes nonzero for every candidate;
+// slots needs room for every docid but no initialising.
+int impact_accumulate(Postings** postings, int nterms, int k, double* acc, char* seen,
+                      int* candidates, int* slots, long* processed)
+{
+    int cursor[32];
+    int numCandidates = 0;
+    int monotone = k >= 1 && k <= SAAT_MAX_K;
+    *processed = 0;
+    if(nterms > 32)
+        nterms = 32;
+    for(int t = 0; t < nterms; t++){
+        cursor[t] = 0;
+        if(postings[t] != NULL && postings[t]->get_impact_count() > 0 &&
+           postings[t]->get_impacts()[postings[t]->get_impact_count() - 1] < 0)
+            monotone = 0;
+    }
+    RunningTop top;
+    top.size = 0;
+    top.capacity = k + 1;
+    top.acc = acc;
+    top.seen = seen;
+    top.slots = slots;
+    while(1){
+        int best = -1;
+        double gain = 0;
+        for(int t = 0; t < nterms; t++){
+            if(postings[t] == NULL || cursor[t] >= postings[t]->get_impact_count())
+                continue;
+            double next = postings[t]->get_impacts()[cursor[t]];
+            gain += next;
+            if(best == -1 || next > postings[best]->get_impacts()[cursor[best]])
+                best = t;
+        }
+        if(best == -1){
+            break;  // every list exhausted
+        }
+        if(monotone && top.size >= k){
+            double kth, next;
+            top_bounds(&top, k, &kth, &next);
+            if(kth > next + gain)
+                break;
+        }
+
+        const int* ids = postings[best]->get_impact_ids();
+        const double* impacts = postings[best]->get_impacts();
+        int end = cursor[best] + SAAT_BLOCK;
+        if(end > postings[best]->get_impact_count())
+            end = postings[best]->get_impact_count();
+        for(int p = cursor[best]; p < end; p++){
+            int doc = ids[p];
+            if(!seen[doc]){
+                seen[doc] = 1;
+                candidates[numCandidates++] = doc;
+            }
+            acc[doc] += impacts[p];
+            if(monotone)
+                top_update(&top, doc);
+        }
+        *processed += end - cursor[best];
+        cursor[best] = end;
+    }
+    return numCandidates;
+}
@@ -0,0 +1,359 @@
+#include "Kernels.hpp"
+using namespace std;
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    #define KERNELS_X86 1
+    #include <immintrin.h>
+    #define TARGET_SSE4 __attribute__((target("sse4.1")))
+    #define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+static atomic<int> detected_level(-1);        // -1 until first use; every thread finds the same
+static thread_local int forced_level = -1;    // set_kernel_level() on this thread, -1 = none
+
+KernelLevel kernel_detect()
+{
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        return KERNEL_AVX2;
+    if(__builtin_cpu_supports("sse4.1"))
+        return KERNEL_SSE4;
+#endif
+    return KERNEL_SCALAR;
+}
+
+KernelLevel kernel_level()
+{
+    if(forced_level != -1)
+        return (KernelLevel)forced_level;
+    int level = detected_level.load(memory_order_relaxed);
+    if(level == -1){
+        level = kernel_detect();
+        detected_level.store(level, memory_order_relaxed);
+    }
+    return (KernelLevel)level;
+}
+
+// Forcing a level is only used to compare kernels; it never goes above
+// what the CPU supports. It applies to the calling thread only, so /bench
+// does not change the kernels a background /reload builds with.
+void set_kernel_level(KernelLevel level)
+{
+    KernelLevel best = kernel_detect();
+    forced_level = level > best ? best : level;
+}
+
+const char* kernel_name(KernelLevel level)
+{
+    switch(level){
+        case KERNEL_AVX2: return "avx2";
+        case KERNEL_SSE4: return "sse4.1";
+        default:          return "scalar";
+    }
+}
+
+// ---------------------------------------------------------------- scalar
+
+static void bm25_scalar(const int* ids, const int* tfs, const double* norms, int n,
+                        double k1plus1, double idf, double* out)
+{
+    for(int i = 0; i < n; i++){
+        double tf = (double)tfs[i];
+        out[i] = idf * ((tf * k1plus1) / (tf + norms[ids[i]]));
+    }
+}
+
+static int filter_scalar(const double* scores, int n, double threshold, int* out)
+{
+    int count = 0;
+    for(int i = 0; i < n; i++){
+        out[count] = i;
+        count += scores[i] > threshold;  // branch-free
+    }
+    return count;
+}
+
+static void delta_scalar(int* values, int n, int base)
+{
+    for(int i = 0; i < n; i++){
+        base += values[i];
+        values[i] = base;
+    }
+}
+
+// One varint gap starting at in[*pos]
+static inline int varint_one(const unsigned char* in, int* pos)
+{
+    unsigned int gap = in[(*pos)++];
+    if(gap >= 0x80){
+        gap &= 0x7F;
+        int shift = 7;
+        unsigned int byte;
+        do{
+            byte = in[(*pos)++];
+            gap |= (byte & 0x7F) << shift;
+            shift += 7;
+        }while(byte >= 0x80);
+    }
+    return (int)gap;
+}
+
+// Reads n varint gaps into gaps, returns the bytes consumed
+static int varint_gaps_scalar(const unsigned char* in, int n, int* gaps)
+{
+    int pos = 0;
+    for(int i = 0; i < n; i++){
+        gaps[i] = varint_one(in, &pos);
+    }
+    return pos;
+}
+
+// ------------------------------------------------------------------- x86
+#ifdef KERNELS_X86
+
+TARGET_SSE4 static void bm25_sse4(const int* ids, const int* tfs, const double* norms, int n,
+                                  double k1plus1, double idf, double* out)
+{
+    __m128d vk = _mm_set1_pd(k1plus1);
+    __m128d vidf = _mm_set1_pd(idf);
+    int i = 0;
+    for(; i + 2 <= n; i += 2){
+        __m128d tf = _mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i*)(tfs + i)));
+        __m128d norm = _mm_set_pd(norms[ids[i + 1]], norms[ids[i]]);
+        __m128d w = _mm_div_pd(_mm_mul_pd(tf, vk), _mm_add_pd(tf, norm));
+        _mm_storeu_pd(out + i, _mm_mul_pd(vidf, w));
+    }
+    bm25_scalar(ids + i, tfs + i, norms, n - i, k1plus1, idf, out + i);
+}
+
+TARGET_AVX2 static void bm25_avx2(const int* ids, const int* tfs, const double* norms, int n,
+                                  double k1plus1, double idf, double* out)
+{
+    __m256d vk = _mm256_set1_pd(k1plus1);
+    __m256d vidf = _mm256_set1_pd(idf);
+    // The masked gather with every lane on is the plain one; GCC warns
+    // about the undefined source register of _mm256_i32gather_pd
+    __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    int i = 0;
+    for(; i + 4 <= n; i += 4){
+        __m128i idx = _mm_loadu_si128((const __m128i*)(ids + i));
+        __m256d tf = _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)(tfs + i)));
+        __m256d norm = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), norms, idx, all, 8);
+        __m256d w = _mm256_div_pd(_mm256_mul_pd(tf, vk), _mm256_add_pd(tf, norm));
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(vidf, w));
+    }
+    bm25_scalar(ids + i, tfs + i, norms, n - i, k1plus1, idf, out + i);
+}
+
+TARGET_SSE4 static int filter_sse4(const double* scores, int n, double threshold, int* out)
+{
+    __m128d thr = _mm_set1_pd(threshold);
+    int count = 0;
+    int i = 0;
+    for(; i + 2 <= n; i += 2){
+        int mask = _mm_movemask_pd(_mm_cmpgt_pd(_mm_loadu_pd(scores + i), thr));
+        // branch-free compaction of the mask bits
+        out[count] = i;     count += mask & 1;
+        out[count] = i + 1; count += (mask >> 1) & 1;
+    }
+    for(; i < n; i++){
+        if(scores[i] > threshold)
+            out[count++] = i;
+    }
+    return count;
+}
+
+TARGET_AVX2 static int filter_avx2(const double* scores, int n, double threshold, int* out)
+{
+    __m256d thr = _mm256_set1_pd(threshold);
+    int count = 0;
+    int i = 0;
+    for(; i + 4 <= n; i += 4){
+        int mask = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(scores + i), thr, _CMP_GT_OQ));
+        if(mask == 0){
+            continue;  // common case once the heap is full
+        }
+        out[count] = i;     count += mask & 1;
+        out[count] = i + 1; count += (mask >> 1) & 1;
+        out[count] = i + 2; count += (mask >> 2) & 1;
+        out[count] = i + 3; count += (mask >> 3) & 1;
+    }
+    for(; i < n; i++){
+        if(scores[i] > threshold)
+            out[count++] = i;
+    }
+    return count;
+}
+
+TARGET_SSE4 static void delta_sse4(int* values, int n, int base)
+{
+    __m128i carry = _mm_set1_epi32(base);
+    int i = 0;
+    for(; i + 4 <= n; i += 4){
+        __m128i x = _mm_loadu_si128((const __m128i*)(values + i));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi32(x, carry);
+        _mm_storeu_si128((__m128i*)(values + i), x);
+        carry = _mm_shuffle_epi32(x, 0xFF);
+    }
+    delta_scalar(values + i, n - i, _mm_cvtsi128_si32(carry));
+}
+
+// Dense lists (and reordered ones) are mostly one-byte gaps: when the
+// next 16 bytes all lack the continuation bit they are 16 gaps and are
+// widened at once. With at least 16 gaps left the encoding has at least
+// 16 more bytes, so the load stays inside it.
+TARGET_SSE4 static int varint_gaps_sse4(const unsigned char* in, int n, int* gaps)
+{
+    int pos = 0;
+    int i = 0;
+    while(i < n){
+        if(n - i >= 16){
+            __m128i bytes = _mm_loadu_si128((const __m128i*)(in + pos));
+            if(_mm_movemask_epi8(bytes) == 0){
+                _mm_storeu_si128((__m128i*)(gaps + i), _mm_cvtepu8_epi32(bytes));
+                _mm_storeu_si128((__m128i*)(gaps + i + 4), _mm_cvtepu8_epi32(_mm_srli_si128(bytes, 4)));
+                _mm_storeu_si128((__m128i*)(gaps + i + 8), _mm_cvtepu8_epi32(_mm_srli_si128(bytes, 8)));
+                _mm_storeu_si128((__m128i*)(gaps + i + 12), _mm_cvtepu8_epi32(_mm_srli_si128(bytes, 12)));
+                pos += 16;
+                i += 16;
+                continue;
+            }
+        }
+        gaps[i++] = varint_one(in, &pos);
+    }
+    return pos;
+}
+
+// Same with 32 bytes per check
+TARGET_AVX2 static int varint_gaps_avx2(const unsigned char* in, int n, int* gaps)
+{
+    int pos = 0;
+    int i = 0;
+    while(i < n){
+        if(n - i >= 32){
+            __m256i bytes = _mm256_loadu_si256((const __m256i*)(in + pos));
+            if(_mm256_movemask_epi8(bytes) == 0){
+                __m128i low = _mm256_castsi256_si128(bytes);
+                __m128i high = _mm256_extracti128_si256(bytes, 1);
+                _mm256_storeu_si256((__m256i*)(gaps + i), _mm256_cvtepu8_epi32(low));
+                _mm256_storeu_si256((__m256i*)(gaps + i + 8), _mm256_cvtepu8_epi32(_mm_srli_si128(low, 8)));
+                _mm256_storeu_si256((__m256i*)(gaps + i + 16), _mm256_cvtepu8_epi32(high));
+                _mm256_storeu_si256((__m256i*)(gaps + i + 24), _mm256_cvtepu8_epi32(_mm_srli_si128(high, 8)));
+                pos += 32;
+                i += 32;
+                continue;
+            }
+        }
+        gaps[i++] = varint_one(in, &pos);
+    }
+    return pos;
+}
+
+TARGET_AVX2 static void delta_avx2(int* values, int n, int base)
+{
+    __m256i carry = _mm256_set1_epi32(base);
+    __m256i last = _mm256_set1_epi32(7);
+    int i = 0;
+    for(; i + 8 <= n; i += 8){
+        __m256i x = _mm256_loadu_si256((const __m256i*)(values + i));
+        // prefix sum inside each 128-bit lane
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+        // carry the low lane's total into the high lane
+        __m256i low = _mm256_permute2x128_si256(x, x, 0x08);
+        x = _mm256_add_epi32(x, _mm256_shuffle_epi32(low, 0xFF));
+        x = _mm256_add_epi32(x, carry);
+        _mm256_storeu_si256((__m256i*)(values + i), x);
+        carry = _mm256_permutevar8x32_epi32(x, last);
+    }
+    delta_scalar(values + i, n - i, _mm_cvtsi128_si32(_mm256_castsi256_si128(carry)));
+}
+
+#endif
+
+// -------------------------------------------------------------- dispatch
+
+void bm25_block(const int* ids, const int* tfs, const double* norms, int n,
+                double k1plus1, double idf, double* out)
+{
+    switch(kernel_level()){
+#ifdef KERNELS_X86
+        case KERNEL_AVX2: bm25_avx2(ids, tfs, norms, n, k1plus1, idf, out); return;
+        case KERNEL_SSE4: bm25_sse4(ids, tfs, norms, n, k1plus1, idf, out); return;
+#endif
+        default:          bm25_scalar(ids, tfs, norms, n, k1plus1, idf, out); return;
+    }
+}
+
+int filter_above(const double* scores, int n, double threshold, int* out)
+{
+    switch(kernel_level()){
+#ifdef KERNELS_X86
+        case KERNEL_AVX2: return filter_avx2(scores, n, threshold, out);
+        case KERNEL_SSE4: return filter_sse4(scores, n, threshold, out);
+#endif
+        default:          return filter_scalar(scores, n, threshold, out);
+    }
+}
+
+void delta_decode(int* values, int n, int base)
+{
+    switch(kernel_level()){
+#ifdef KERNELS_X86
+        case KERNEL_AVX2: delta_avx2(values, n, base); return;
+        case KERNEL_SSE4: delta_sse4(values, n, base); return;
+#endif
+        default:          delta_scalar(values, n, base); return;
+    }
+}
+
+// ---------------------------------------------------------------- varint
+
+int varint_encode(const int* ids, int n, unsigned char* out)
+{
+    int pos = 0;
+    int prev = 0;
+    for(int i = 0; i < n; i++){
+        unsigned int gap = (unsigned int)(ids[i] - prev);
+        prev = ids[i];
+        while(gap >= 0x80){
+            out[pos++] = (unsigned char)(gap | 0x80);
+            gap >>= 7;
+        }
+        out[pos++] = (unsigned char)gap;
+    }
+    return pos;
+}
+
+// Returns the number of bytes consumed
+int varint_decode(const unsigned char* in, int n, int* ids)
+{
+    int pos;
+    switch(kernel_level()){
+#ifdef KERNELS_X86
+        case KERNEL_AVX2: pos = varint_gaps_avx2(in, n, ids); break;
+        case KERNEL_SSE4: pos = varint_gaps_sse4(in, n, ids); break;
+#endif
+        default:          pos = varint_gaps_scalar(in, n, ids); break;
+    }
+    delta_decode(ids, n, 0);
+    return pos;
+}
+
+int varint_size(const int* ids, int n)
+{
+    int size = 0;
+    int prev = 0;
+    for(int i = 0; i < n; i++){
+        unsigned int gap = (unsigned int)(ids[i] - prev);
+        prev = ids[i];
+        do{
+            size++;
+            gap >>= 7;
+        }while(gap);
+    }
+    return size;
+}
@@ -2,8 +2,14 @@
 
 listnode::~listnode()
 {
-    if(next!=NULL)
-        delete(next);
+    // Iterative: a recursive delete overflows the stack on long chains
+    listnode* node=next;
+    while(node!=NULL){
+        listnode* following=node->next;
+        node->next=NULL;
+        delete node;
+        node=following;
+    }
 }
 void listnode::add(int docId)
 {
@@ -32,10 +38,22 @@ int listnode::search(int docId)
 
 int listnode::volume()
 {
-    if(next != NULL) 
-        return 1 + next->volume();
-    else 
-        return 1;
+    int count=0;
+    for(listnode* node=this; node!=NULL; node=node->next)
+        count++;
+    return count;
+}
+// Documents are indexed in ascending order, so only the tail can match:
+// called on the tail, this is O(1) instead of walking the whole chain.
+// Returns the new tail.
+listnode* listnode::append(int docId)
+{
+    if(docId==id){
+        times++;
+        return this;
+    }
+    next=new listnode(docId);
+    return next;
 }
 int listnode::passdocuments(Scorelist* scorelist){
     scorelist->insert(id);
@@ -43,4 +61,14 @@ int listnode::passdocuments(Scorelist* scorelist){
         return next->passdocuments(scorelist);
     }
     return 0;
+}
+// Copy the chain into parallel arrays (iterative: chains can be long)
+int listnode::flatten(int* ids, int* tfs){
+    int n=0;
+    for(listnode* node=this; node!=NULL; node=node->next){
+        ids[n]=node->id;
+        tfs[n]=node->times;
+        n++;
+    }
+    return n;
 }
\ No newline at end of file
@@ -1,17 +1,21 @@
 #include "Map.hpp"
 using namespace std;
 // Constructor
-Mymap::Mymap(int size, int buffersize) : size(size), buffersize(buffersize)
+Mymap::Mymap(int size, int buffersize) : size(size), buffersize(buffersize), avgdl(1.0), norms(nullptr),
+    title_norms(nullptr), body_norms(nullptr), original_ids(nullptr), internal_ids(nullptr),
+    source(nullptr), offsets(nullptr), text_lengths(nullptr), docbuffer(nullptr)
 {
     // Allocate arrays
     documents = new char *[size];
     doc_lengths = new int[size];
+    title_lengths = new int[size];
 
     // Initialize to prevent undefined behavior
     for (int i = 0; i < size; i++)
     {
         documents[i] = nullptr;
         doc_lengths[i] = 0;
+        title_lengths[i] = 0;
     }
 }
 // Destructor
@@ -23,38 +27,178 @@ Mymap::~Mymap()
     }
     delete[] documents;
     delete[] doc_lengths;
-}
-int Mymap::insert(char* line, int i){
-    if(line == nullptr || i < 0 || i >= size){
-        return -1;
+    delete[] norms;
+    delete[] title_lengths;
+    delete[] title_norms;
+    delete[] body_norms;
+    delete[] original_ids;
+    delete[] internal_ids;
+    delete[] offsets;
+    delete[] text_lengths;
+    delete[] docbuffer;
+    if(source != nullptr){
+        fclose(source);
     }
-    
+}
+// Strips the newline and surrounding spaces/tabs in place.
+// Returns the first kept character and sets len to the kept length.
+char* Mymap::trim(char* line, int* len){
     // Remove newline if present
-    int len = strlen(line);
-    if(len > 0 && line[len-1] == '\n'){
-        line[len-1] = '\0';
-        len--;
+    *len = strlen(line);
+    if(*len > 0 && line[*len-1] == '\n'){
+        line[*len-1] = '\0';
+        (*len)--;
     }
     
     // Trim leading spaces
     char* start = line;
     while(*start == ' ' || *start == '\t'){
         start++;
-        len--;
+        (*len)--;
     }
     
     // Trim trailing spaces
-    char* end = start + len - 1;
+    char* end = start + *len - 1;
     while(end > start && (*end == ' ' || *end == '\t')){
         *end = '\0';
         end--;
-        len--;
+        (*len)--;
+    }
+    return start;
+}
+int Mymap::insert(char* line, int i){
+    if(line == nullptr || i < 0 || i >= size){
+        return -1;
     }
     
+    int len;
+    char* start = trim(line, &len);
+    
     // Allocate memory for this document
     documents[i] = new char[len + 1];
     strcpy(documents[i], start);
     // doc_lengths will be set by split() with word count for BM25
     
     return 1;
-} 
\ No newline at end of file
+}
+// Switch to streaming mode: documents stay in file (which Mymap now
+// owns) and are read back one at a time by getDocument()
+void Mymap::set_source(FILE* file){
+    source = file;
+    offsets = new long[size];
+    text_lengths = new int[size];
+    docbuffer = new char[buffersize + 1];
+    for(int i = 0; i < size; i++){
+        offsets[i] = 0;
+        text_lengths[i] = 0;
+    }
+}
+// Streaming counterpart of insert(): remembers where the trimmed text of
+// line (read from offset in the source file) lives instead of copying it.
+// Returns the trimmed text for indexing, nullptr on error.
+char* Mymap::insert_offset(char* line, long offset, int i){
+    if(line == nullptr || i < 0 || i >= size || offsets == nullptr){
+        return nullptr;
+    }
+    int len;
+    char* start = trim(line, &len);
+    offsets[i] = offset + (start - line);
+    text_lengths[i] = len;
+    return start;
+}
+const char* Mymap::load(int i) const{
+    if(fseek(source, offsets[i], SEEK_SET) != 0){
+        docbuffer[0] = '\0';
+        return docbuffer;
+    }
+    size_t got = fread(docbuffer, 1, text_lengths[i], source);
+    docbuffer[got] = '\0';
+    return docbuffer;
+}
+// Precompute k1*(1-b+b*doclen/avgdl) once so scoring does not redo it
+// for every (term, document) pair. Call after all lengths are set.
+void Mymap::compute_norms(double k1, double b){
+    avgdl=0;
+    for(int i=0;i<size;i++){
+        avgdl+=(double)doc_lengths[i];
+    }
+    if(size>0){
+        avgdl/=(double)size;
+    }
+    if(avgdl==0){
+        avgdl=1.0;  // Prevent division by zero
+    }
+    if(norms==nullptr){
+        norms=new double[size];
+    }
+    for(int i=0;i<size;i++){
+        norms[i]=k1*(1.0-b+b*((double)doc_lengths[i]/avgdl));
+    }
+}
+// BM25F length norms (without k1): one per field, each against that
+// field's own average length.
+void Mymap::compute_field_norms(double b){
+    double avgtitle=0, avgbody=0;
+    for(int i=0;i<size;i++){
+        avgtitle+=(double)title_lengths[i];
+        avgbody+=(double)(doc_lengths[i]-title_lengths[i]);
+    }
+    if(size>0){
+        avgtitle/=(double)size;
+        avgbody/=(double)size;
+    }
+    if(avgtitle==0){
+        avgtitle=1.0;
+    }
+    if(avgbody==0){
+        avgbody=1.0;
+    }
+    if(title_norms==nullptr){
+        title_norms=new double[size];
+        body_norms=new double[size];
+    }
+    for(int i=0;i<size;i++){
+        title_norms[i]=1.0-b+b*((double)title_lengths[i]/avgtitle);
+        body_norms[i]=1.0-b+b*((double)(doc_lengths[i]-title_lengths[i])/avgbody);
+    }
+}
+// Renumber documents: order[new] is the current id of the document that
+// becomes docid new. Norms must be computed afterwards.
+void Mymap::reorder(const int* order){
+    char **newdocs = new char *[size];
+    int *newlengths = new int[size];
+    int *newtitles = new int[size];
+    int *neworiginal = new int[size];
+    for(int i=0;i<size;i++){
+        newdocs[i]=documents[order[i]];
+        newlengths[i]=doc_lengths[order[i]];
+        newtitles[i]=title_lengths[order[i]];
+        neworiginal[i]=original_id(order[i]);
+    }
+    delete[] documents;
+    delete[] doc_lengths;
+    delete[] title_lengths;
+    delete[] original_ids;
+    if(offsets != nullptr){
+        long *newoffsets = new long[size];
+        int *newtextlengths = new int[size];
+        for(int i=0;i<size;i++){
+            newoffsets[i]=offsets[order[i]];
+            newtextlengths[i]=text_lengths[order[i]];
+        }
+        delete[] offsets;
+        delete[] text_lengths;
+        offsets=newoffsets;
+        text_lengths=newtextlengths;
+    }
+    documents=newdocs;
+    doc_lengths=newlengths;
+    title_lengths=newtitles;
+    original_ids=neworiginal;
+    if(internal_ids==nullptr){
+        internal_ids=new int[size];
+    }
+    for(int i=0;i<size;i++){
+        internal_ids[original_ids[i]]=i;
+    }
+}
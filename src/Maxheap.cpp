@@ -1,4 +1,5 @@
 #include "Maxheap.hpp"
+#include <cmath>
 using namespace std;
 
 Maxheap::Maxheap(int k):
@@ -13,17 +14,30 @@ Maxheap::Maxheap(int k):
         heap[i] = 0.0;
     }
 }
+// Higher score first; equal scores in docid order, so every evaluator
+// (and every page of one query) agrees on the ranking
+static int ranks_above(double score1,int id1,double score2,int id2){
+    return score1>score2 || (score1==score2 && id1<id2);
+}
 int Maxheap::minindex(int low,int high){
     int min=low;
-    double minscore=heap[low];
     for(int i=low;i<high;i++){
-        if(heap[i]<minscore){
+        if(ranks_above(heap[min],ids[min],heap[i],ids[i])){
             min=i;
-            minscore=heap[i];
         }
     }
     return min;
 }
+// Score a new entry has to beat to get in; -inf until the heap is full
+double Maxheap::get_min(){
+    if(maxnumofscores<=0){
+        return HUGE_VAL;
+    }
+    if(curnumofscores<maxnumofscores){
+        return -HUGE_VAL;
+    }
+    return heap[minindex(maxnumofscores/2,maxnumofscores)];
+}
 void Maxheap::swapscore(int index1,int index2){
     double temp=0.0;
     temp=heap[index1];
@@ -42,7 +56,7 @@ void Maxheap::insert(double score,int id){
     }
     else{
         int tempindex=minindex(maxnumofscores/2,maxnumofscores);
-        if(score>heap[tempindex]){
+        if(ranks_above(score,id,heap[tempindex],ids[tempindex])){
             index=tempindex;
         }
         else{
@@ -51,14 +65,14 @@ void Maxheap::insert(double score,int id){
     }
     heap[index]=score;
     ids[index]=id;
-    while(index > 0 && heap[index]>heap[(index-1)/2]){
+    while(index > 0 && ranks_above(heap[index],ids[index],heap[(index-1)/2],ids[(index-1)/2])){
         swapscore(index,(index-1)/2);
         index=(index-1)/2;
     }
 }
 int Maxheap::MaxChild(int number1,int number2){
     if(number1<curnumofscores && number2<curnumofscores){
-        if(heap[number1]>heap[number2]){
+        if(ranks_above(heap[number1],ids[number1],heap[number2],ids[number2])){
             return number1;
         }
         else{
@@ -86,7 +100,7 @@ double Maxheap::remove(){
         ids[0]=ids[curnumofscores];
         while(1){
             chosenchild=MaxChild(2*index+1,2*index+2);
-            if(chosenchild!=-1 && heap[chosenchild]>heap[index]){
+            if(chosenchild!=-1 && ranks_above(heap[chosenchild],ids[chosenchild],heap[index],ids[index])){
                 swapscore(chosenchild,index);
                 index=chosenchild;
             }
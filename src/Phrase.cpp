@@ -0,0 +1,307 @@
+#include "Phrase.hpp"
+#include "Document_store.hpp"
+#include <climits>
+using namespace std;
+
+const long BIGRAM_SLOTS = 1 << 16;   // Initial fingerprint table size (power of two)
+const int PAIR_BUFFER = 512;         // Keys longer than this are built on the heap
+
+int parse_bigrams(const char* text, BigramOptions* options)
+{
+    if(!strncmp(text, "list:", 5)){
+        options->mode = BIGRAMS_LIST;
+        options->minimum = 1;
+        options->list = text + 5;
+        return text[5] != '\0' ? 1 : -1;
+    }
+    char* end;
+    long minimum = strtol(text, &end, 10);
+    if(end == text || *end != '\0' || minimum < 2 || minimum > INT_MAX)
+        return -1;
+    options->mode = BIGRAMS_FREQUENT;
+    options->minimum = (int)minimum;
+    options->list = NULL;
+    return 1;
+}
+
+// FNV-1a of "first second"; 0 marks an empty slot
+static uint64_t fingerprint(const char* first, const char* second)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for(const char* p = first; *p != '\0'; p++){
+        hash = (hash ^ (unsigned char)*p) * 1099511628211ULL;
+    }
+    hash = (hash ^ (unsigned char)' ') * 1099511628211ULL;
+    for(const char* p = second; *p != '\0'; p++){
+        hash = (hash ^ (unsigned char)*p) * 1099511628211ULL;
+    }
+    return hash != 0 ? hash : 1;
+}
+
+// Words never contain spaces, so "first second" is unambiguous
+static char* pair_key(const char* first, const char* second, char* buffer, int* length)
+{
+    size_t a = strlen(first), b = strlen(second);
+    char* key = a + b + 2 <= (size_t)PAIR_BUFFER ? buffer : (char*)malloc(a + b + 2);
+    memcpy(key, first, a);
+    key[a] = ' ';
+    memcpy(key + a + 1, second, b + 1);
+    *length = (int)(a + b + 1);
+    return key;
+}
+
+BigramIndex::BigramIndex(int minimum)
+    : pairs(new TrieNode()), capacity(BIGRAM_SLOTS), used(0), minimum(minimum), limit(0), decrements(0)
+{
+    keys = (uint64_t*)calloc(capacity, sizeof(uint64_t));
+    counts = (int*)calloc(capacity, sizeof(int));
+}
+
+BigramIndex::~BigramIndex()
+{
+    delete pairs;
+    free(keys);
+    free(counts);
+}
+
+long BigramIndex::slot(uint64_t key) const
+{
+    long s = (long)(key & (uint64_t)(capacity - 1));
+    while(keys[s] != 0 && keys[s] != key){
+        s = (s + 1) & (capacity - 1);
+    }
+    return s;
+}
+
+// Moves the pairs to a table of newcapacity slots, first taking drop off
+// every count; pairs left with less than 1 are not kept
+void BigramIndex::rebuild(long newcapacity, int drop)
+{
+    uint64_t* oldkeys = keys;
+    int* oldcounts = counts;
+    long oldcapacity = capacity;
+    capacity = newcapacity;
+    keys = (uint64_t*)calloc(capacity, sizeof(uint64_t));
+    counts = (int*)calloc(capacity, sizeof(int));
+    used = 0;
+    for(long i = 0; i < oldcapacity; i++){
+        if(oldkeys[i] != 0 && oldcounts[i] - drop >= 1){
+            long s = slot(oldkeys[i]);
+            keys[s] = oldkeys[i];
+            counts[s] = oldcounts[i] - drop;
+            used++;
+        }
+    }
+    free(oldkeys);
+    free(oldcounts);
+}
+
+void BigramIndex::count(const char* first, const char* second)
+{
+    while(2 * (used + 1) > capacity){
+        if(limit > 0 && 2 * table_bytes() > limit){
+            rebuild(capacity, 1);  // full: thin out instead of growing
+            decrements++;
+        } else {
+            rebuild(2 * capacity, 0);
+        }
+    }
+    uint64_t key = fingerprint(first, second);
+    long s = slot(key);
+    if(keys[s] == 0){
+        keys[s] = key;
+        used++;
+    }
+    if(counts[s] < INT_MAX){
+        counts[s]++;
+    }
+}
+
+// Keeps only the pairs counted at least minimum times, in a table sized
+// for them
+void BigramIndex::select()
+{
+    long kept = 0;
+    for(long i = 0; i < capacity; i++){
+        kept += keys[i] != 0 && counts[i] >= minimum;
+    }
+    long newcapacity = 16;
+    while(newcapacity < 2 * (kept + 1))
+        newcapacity *= 2;
+    // every count stays >= 1: pairs below minimum are dropped by the
+    // drop of minimum - 1, and 1 is all add() needs
+    rebuild(newcapacity, minimum - 1);
+    minimum = 1;
+}
+
+// Hands the pairs indexed so far to the caller and starts an empty trie
+// (a streaming build writes each batch's pairs to its run)
+TrieNode* BigramIndex::take_pairs()
+{
+    TrieNode* taken = pairs;
+    pairs = new TrieNode();
+    return taken;
+}
+
+// Called by split() for every adjacent pair of a document; returns the
+// bytes the pair trie allocated. A fingerprint collision at worst indexes
+// one extra pair; its list is still exact.
+long BigramIndex::add(const char* first, const char* second, int id)
+{
+    if(keys == NULL){
+        return 0;  // finalized
+    }
+    long s = slot(fingerprint(first, second));
+    if(keys[s] == 0 || counts[s] < minimum){
+        return 0;
+    }
+    char buffer[PAIR_BUFFER];
+    int length;
+    char* key = pair_key(first, second, buffer, &length);
+    long bytes = pairs->insert(key, id);
+    if(key != buffer){
+        free(key);
+    }
+    return bytes;
+}
+
+void BigramIndex::finalize()
+{
+    pairs->finalize();
+    free(keys);
+    free(counts);
+    keys = NULL;
+    counts = NULL;
+    capacity = 0;
+    used = 0;
+}
+
+Postings* BigramIndex::find(const char* first, const char* second)
+{
+    char buffer[PAIR_BUFFER];
+    int length;
+    char* key = pair_key(first, second, buffer, &length);
+    Postings* postings = pairs->find(key, 0, length);
+    if(key != buffer){
+        free(key);
+    }
+    return postings;
+}
+
+// Reads "first second" lines; other lines are reported and skipped.
+// Returns the number of pairs, -1 if the file cannot be read.
+int load_bigram_list(BigramIndex* bigrams, const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if(file == NULL){
+        build_log() << "Cannot open bigram list: " << path << endl;
+        return -1;
+    }
+    char* line = NULL;
+    size_t buffersize = 0;
+    int loaded = 0, number = 0;
+    while(getline(&line, &buffersize, file) != -1){
+        number++;
+        char* rest;
+        char* first = strtok_r(line, " \t\r\n", &rest);
+        char* second = first != NULL ? strtok_r(NULL, " \t\r\n", &rest) : NULL;
+        if(first == NULL){
+            continue;  // blank line
+        }
+        if(second == NULL || strtok_r(NULL, " \t\r\n", &rest) != NULL){
+            build_log() << "Skipping line " << number << " of " << path << ": expected two words" << endl;
+            continue;
+        }
+        bigrams->count(first, second);
+        loaded++;
+    }
+    free(line);
+    fclose(file);
+    return loaded;
+}
+
+static int is_separator(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+// Whether text has words[0..nwords) as consecutive words, split the way
+// split() splits documents
+static int contains_phrase(const char* text, const char* const* words, int nwords)
+{
+    const char* p = text;
+    while(*p != '\0'){
+        while(is_separator(*p))
+            p++;
+        if(*p == '\0')
+            break;
+        const char* q = p;
+        int w = 0;
+        while(w < nwords){
+            size_t len = strlen(words[w]);
+            if(strncmp(q, words[w], len) != 0 || (q[len] != '\0' && !is_separator(q[len])))
+                break;
+            q += len;
+            while(is_separator(*q))
+                q++;
+            w++;
+        }
+        if(w == nwords)
+            return 1;
+        while(*p != '\0' && !is_separator(*p))
+            p++;
+    }
+    return 0;
+}
+
+// Every pair with a bigram list narrows docs by that list; the words no
+// indexed pair covers narrow it by their own lists. Two words answered
+// by their pair's list need nothing more; otherwise each document left
+// is checked against its text.
+long phrase_documents(const char* const* words, int nwords, TrieNode* trie, BigramIndex* bigrams,
+                      Mymap* map, Bitmap* docs, int* indexed)
+{
+    *indexed = 0;
+    if(nwords <= 0){
+        return 0;
+    }
+    char* covered = (char*)calloc(nwords, sizeof(char));
+    for(int i = 0; bigrams != NULL && i + 1 < nwords; i++){
+        Postings* pair = bigrams->find(words[i], words[i + 1]);
+        if(pair != NULL){
+            docs->and_ids(pair->get_ids(), pair->get_count());
+            covered[i] = covered[i + 1] = 1;
+            (*indexed)++;
+        }
+    }
+    const char** rest = (const char**)malloc(nwords*sizeof(char*));
+    Postings** lists = (Postings**)malloc(nwords*sizeof(Postings*));
+    int nrest = 0;
+    for(int i = 0; i < nwords; i++){
+        if(!covered[i])
+            rest[nrest++] = words[i];
+    }
+    trie->lookup(rest, nrest, lists);
+    for(int i = 0; i < nrest; i++){
+        if(lists[i] == NULL)
+            docs->and_ids(NULL, 0);  // a word that is not indexed: no document
+        else if(lists[i]->get_bitmap() != NULL)
+            docs->and_with(*lists[i]->get_bitmap());
+        else
+            docs->and_ids(lists[i]->get_ids(), lists[i]->get_count());
+    }
+    free(lists);
+    free(rest);
+    free(covered);
+
+    long checked = 0;
+    if(nwords == 1 || (nwords == 2 && *indexed == 1)){
+        return checked;
+    }
+    for(int doc = docs->next(0); doc != -1; doc = docs->next(doc + 1)){
+        checked++;
+        if(!contains_phrase(map->getDocument(doc), words, nwords))
+            docs->reset(doc);
+    }
+    return checked;
+}
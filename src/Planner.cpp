@@ -0,0 +1,287 @@
+#include "Planner.hpp"
+#include "Filter.hpp"
+using namespace std;
+
+// Cost model, in postings added into the dense accumulator. Merging n
+// lists document by document costs more per posting, WAND more again
+// (it re-sorts its cursors every step), and the accumulator costs a
+// little per document of the collection. The constants are hand-set
+// round numbers, not a fit (see postings.md section 7 for how well they
+// pick on the file searchengine_check generates).
+const double DENSE_PER_DOC = 0.06;   // clearing acc and seen
+const double DAAT_PER_TERM = 0.25;   // cursor comparisons per posting and list
+const double WAND_PER_TERM = 0.5;    // cursor sorting per posting and list
+const double PROBE_COST = 3.0;       // one binary-search step while skipping
+
+struct BoundBuild
+{
+    TrieNode* titles;
+    TermContext context;
+    double* weights;
+    int* ids;  // room to decode a bitmap word
+};
+
+// Best weight of any posting of one word at idf 1. Every policy is
+// linear in idf, so idf * max_weight bounds the word's contribution.
+template <class Scorer>
+static void bound_term(const char* word, Postings* postings, void* arg)
+{
+    BoundBuild* build = (BoundBuild*)arg;
+    build->context.body = postings;
+    build->context.ids = postings->decode_ids(build->ids);
+    build->context.title = NULL;
+    if(Scorer::uses_titles && build->titles != NULL){
+        build->context.title = build->titles->find((char*)word, 0, strlen(word));
+    }
+    Scorer::weights(build->context, 1.0, build->weights);
+    double best = 0;
+    for(int i = 0; i < postings->get_count(); i++){
+        if(build->weights[i] > best)
+            best = build->weights[i];
+    }
+    // A sum of weights may round up where the sum of bounds rounds down
+    postings->set_max_weight(best * (1.0 + 1e-9));
+}
+
+void compute_max_weights(TrieNode* trie, TrieNode* titles, Mymap* map, ScorerType type, ScorerParams params)
+{
+    int N = map->get_size() > 0 ? map->get_size() : 1;
+    BoundBuild build;
+    build.titles = titles;
+    build.context.norms = map->get_norms();
+    build.context.title_norms = map->get_title_norms();
+    build.context.body_norms = map->get_body_norms();
+    build.context.params = params;
+    build.weights = (double*)malloc(N*sizeof(double));
+    build.ids = (int*)malloc(N*sizeof(int));
+    char* buffer = (char*)malloc((map->get_buffersize() + 2)*sizeof(char));
+
+    TermVisitor visitor;
+    switch(type){
+        case SCORER_BM25PLUS: visitor = bound_term<BM25Plus>; break;
+        case SCORER_TFIDF:    visitor = bound_term<TfIdf>; break;
+        case SCORER_BM25F:    visitor = bound_term<BM25F>; break;
+        default:              visitor = bound_term<BM25>; break;
+    }
+    trie->visit(buffer, 0, visitor, &build);
+
+    free(buffer);
+    free(build.ids);
+    free(build.weights);
+}
+
+struct BitmapBuild
+{
+    int N;
+    int minimum;  // df from which a word gets a bitmap
+};
+
+static void bitmap_term(const char*, Postings* postings, void* arg)
+{
+    BitmapBuild* build = (BitmapBuild*)arg;
+    if(postings->get_count() >= build->minimum){
+        postings->to_bitmap(build->N);
+    }
+}
+
+// Every word found in at least 1/BITMAP_DENSITY of the documents keeps
+// its ids as a bitmap instead of an array (the break-even point Roaring
+// uses for its containers: 4 bytes per id against N/8 bytes). Run once
+// docids are final; only the main trie's words, title and pair lists stay
+// arrays.
+void build_bitmaps(TrieNode* trie, Mymap* map)
+{
+    BitmapBuild build;
+    build.N = map->get_size();
+    build.minimum = build.N / BITMAP_DENSITY > 1 ? build.N / BITMAP_DENSITY : 2;
+    char* buffer = (char*)malloc((map->get_buffersize() + 2)*sizeof(char));
+    trie->visit(buffer, 0, bitmap_term, &build);
+    free(buffer);
+}
+
+static double policy_idf(ScorerType type, double N, double df)
+{
+    switch(type){
+        case SCORER_BM25PLUS: return BM25Plus::idf(N, df);
+        case SCORER_TFIDF:    return TfIdf::idf(N, df);
+        case SCORER_BM25F:    return BM25F::idf(N, df);
+        default:              return BM25::idf(N, df);
+    }
+}
+
+static double log2_1p(double x)
+{
+    return log(1.0 + x) / log(2.0);
+}
+
+// Turns counters measured while evaluating (or predicted by plan_query)
+// into the same cost units: postings scored plus binary-search probes
+double strategy_cost(PlanStrategy strategy, const QueryPlan* plan, long scored, long probes, int N)
+{
+    switch(strategy){
+        case PLAN_DENSE:
+        case PLAN_IMPACT:  // same accumulator, usually fewer postings
+            return scored + DENSE_PER_DOC * N;
+        case PLAN_WAND:
+            return scored * (1.0 + WAND_PER_TERM * plan->nkept) + PROBE_COST * probes;
+        default:
+            return scored * (1.0 + DAAT_PER_TERM * plan->nkept) + PROBE_COST * probes;
+    }
+}
+
+void plan_query(QueryPlan* plan, const char* const* words, int nwords, TrieNode* trie, TrieNode* titles,
+                BigramIndex* bigrams, Mymap* map, ScorerType type, int k, int impacts, SearchAfter after)
+{
+    double N = (double)map->get_size();
+    int positive = 0;
+    if(nwords > PLAN_MAX_TERMS)
+        nwords = PLAN_MAX_TERMS;
+    int excluded[PLAN_MAX_TERMS];
+    int quoted[PLAN_MAX_TERMS];
+    const char* stripped[PLAN_MAX_TERMS];
+    plan->nterms = nwords;
+    int operators = parse_operators(plan, words, nwords, excluded, quoted);
+    for(int l = 0; l < nwords; l++)
+        stripped[l] = plan->terms[l].word;
+
+    // Every word is looked up in one interleaved walk of the trie
+    Postings* bodies[PLAN_MAX_TERMS];
+    Postings* fields[PLAN_MAX_TERMS];
+    trie->lookup(stripped, nwords, bodies);
+    if(type == SCORER_BM25F && titles != NULL)
+        titles->lookup(stripped, nwords, fields);
+    for(int l = 0; l < nwords; l++){
+        PlanTerm* term = &plan->terms[l];
+        term->body = bodies[l];
+        term->title = NULL;
+        term->df = term->body != NULL ? term->body->get_count() : 0;
+        term->idf = 0;
+        term->weight = 0;
+        term->upper = 0;
+        if(excluded[l]){
+            term->status = TERM_EXCLUDED;
+            continue;
+        }
+        if(term->body == NULL){
+            term->status = TERM_MISSING;
+            continue;
+        }
+        if(type == SCORER_BM25F && titles != NULL)
+            term->title = fields[l];
+        term->idf = policy_idf(type, N, (double)term->df);
+        term->status = term->idf > 0 ? TERM_KEPT : TERM_DROPPED;
+        if(term->idf > 0)
+            positive++;
+    }
+
+    // Rarest first; a word made only of common terms still gets ranked
+    plan->nkept = 0;
+    plan->postings = 0;
+    for(int l = 0; l < nwords; l++){
+        PlanTerm* term = &plan->terms[l];
+        if(term->status == TERM_DROPPED && positive == 0)
+            term->status = TERM_FLOORED;
+        if(term->status != TERM_KEPT && term->status != TERM_FLOORED)
+            continue;
+        term->weight = term->status == TERM_KEPT ? term->idf : IDF_FLOOR;
+        term->upper = term->weight * term->body->get_max_weight();
+        int pos = plan->nkept++;
+        while(pos > 0 && plan->terms[plan->order[pos - 1]].df > term->df){
+            plan->order[pos] = plan->order[pos - 1];
+            pos--;
+        }
+        plan->order[pos] = l;
+        plan->postings += term->df;
+    }
+
+    build_filter(plan, operators, quoted, trie, bigrams, map);
+    if(plan->filter != NULL)
+        impacts = 0;  // score-at-a-time cannot skip filtered documents safely
+    // Same for the hits of earlier pages (/search also passes impacts = 0
+    // for the first page of a paged search, whose cursor must be exact)
+    plan->after = after;
+    if(after.id >= 0)
+        impacts = 0;
+
+    int n = plan->nkept;
+    for(int s = 0; s < PLAN_STRATEGIES; s++)
+        plan->estimates[s] = -1;
+    plan->estimates[PLAN_DENSE] = strategy_cost(PLAN_DENSE, plan, plan->postings, 0, (int)N);
+    plan->estimates[PLAN_DAAT] = strategy_cost(PLAN_DAAT, plan, plan->postings, 0, (int)N);
+    if(n > 1){
+        // wand: once the shorter lists have supplied k documents the
+        // longest list is mostly skipped, probed once per document of
+        // the others; before that it is scored like daat
+        long longest = plan->terms[plan->order[n - 1]].df;
+        long others = plan->postings - longest;
+        if(others >= k){
+            long probed = others < longest ? others : longest;
+            plan->estimates[PLAN_WAND] = strategy_cost(PLAN_WAND, plan, others + probed,
+                (long)(probed * log2_1p((double)longest / (probed > 0 ? probed : 1))), (int)N);
+        } else {
+            plan->estimates[PLAN_WAND] = strategy_cost(PLAN_WAND, plan, plan->postings, 0, (int)N);
+        }
+
+        // conjunctive: walk the rarest list and probe the rest, worth it
+        // only when independence predicts at least k common documents
+        // (or every word is a +word, so nothing else can match anyway)
+        double common = N;
+        int required = 0;
+        for(int i = 0; i < n; i++){
+            common *= plan->terms[plan->order[i]].df / (N > 0 ? N : 1);
+            required += plan->terms[plan->order[i]].required;
+        }
+        if(common >= k || required == n){
+            long rarest = plan->terms[plan->order[0]].df;
+            double probes = 0;
+            for(int i = 1; i < n; i++){
+                const PlanTerm* term = &plan->terms[plan->order[i]];
+                if(term->body->get_bitmap() != NULL)
+                    probes += rarest / PROBE_COST;  // one bit test
+                else
+                    probes += rarest * log2_1p((double)term->df / rarest);
+            }
+            plan->estimates[PLAN_CONJUNCTIVE] = strategy_cost(PLAN_CONJUNCTIVE, plan,
+                (long)(rarest + common * (n - 1)), (long)probes, (int)N);
+        }
+    }
+    if(plan->filter != NULL){
+        // filtered: every list gallops to each allowed document
+        double allowed = plan->filter->cardinality();
+        double probes = 0;
+        for(int i = 0; i < n; i++)
+            probes += allowed * log2_1p(plan->terms[plan->order[i]].df / (allowed > 0 ? allowed : 1));
+        plan->estimates[PLAN_FILTERED] = strategy_cost(PLAN_FILTERED, plan, (long)(allowed * n), (long)probes, (int)N);
+    }
+    int floored = n > 0 && plan->terms[plan->order[0]].status == TERM_FLOORED;
+    if(impacts && !floored){
+        long impactPostings = 0;
+        for(int i = 0; i < n; i++)
+            impactPostings += plan->terms[plan->order[i]].body->get_impact_count();
+        plan->estimates[PLAN_IMPACT] = strategy_cost(PLAN_IMPACT, plan, impactPostings, 0, (int)N);
+    }
+
+    plan->strategy = PLAN_DENSE;
+    for(int s = 0; s < PLAN_STRATEGIES; s++){
+        if(plan->estimates[s] >= 0 && plan->estimates[s] < plan->estimates[plan->strategy])
+            plan->strategy = (PlanStrategy)s;
+    }
+}
+
+void release_plan(QueryPlan* plan)
+{
+    delete plan->filter;
+    plan->filter = NULL;
+}
+
+const char* strategy_name(PlanStrategy strategy)
+{
+    switch(strategy){
+        case PLAN_DAAT:        return "daat";
+        case PLAN_WAND:        return "wand";
+        case PLAN_CONJUNCTIVE: return "conjunctive";
+        case PLAN_IMPACT:      return "impact";
+        case PLAN_FILTERED:    return "filtered";
+        default:               return "dense";
+    }
+}
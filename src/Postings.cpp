@@ -0,0 +1,124 @@
+#include "Postings.hpp"
+using namespace std;
+
+Postings::Postings(listnode* list) : ids(NULL), tfs(NULL), count(0),
+    impact_ids(NULL), impacts(NULL), impact_count(0), max_weight(0), bitmap(NULL)
+{
+    if(list == NULL){
+        return;
+    }
+    count = list->volume();
+    ids = (int*)malloc(count*sizeof(int));
+    tfs = (int*)malloc(count*sizeof(int));
+    list->flatten(ids, tfs);
+}
+
+// Takes ownership of two malloc'ed arrays (ids ascending)
+Postings::Postings(int* ids, int* tfs, int count) : ids(ids), tfs(tfs), count(count),
+    impact_ids(NULL), impacts(NULL), impact_count(0), max_weight(0), bitmap(NULL)
+{
+}
+
+Postings::~Postings()
+{
+    free(ids);
+    free(tfs);
+    free(impact_ids);
+    free(impacts);
+    delete bitmap;
+}
+
+// Takes ownership of two malloc'ed arrays
+void Postings::set_impacts(int* newids, double* newimpacts, int n)
+{
+    free(impact_ids);
+    free(impacts);
+    impact_ids = newids;
+    impacts = newimpacts;
+    impact_count = n;
+}
+
+// Keeps the ids as a bitmap over N documents and frees the array. Run
+// once the docids are final.
+void Postings::to_bitmap(int N)
+{
+    if(bitmap != NULL)
+        return;
+    bitmap = new Bitmap(ids, count, N);
+    bitmap->build_ranks();
+    free(ids);
+    ids = NULL;
+}
+
+// The docids in order: the array itself, or the bitmap written out into
+// buffer (room for get_count() ids)
+const int* Postings::decode_ids(int* buffer) const
+{
+    if(bitmap == NULL)
+        return ids;
+    bitmap->decode(buffer);
+    return buffer;
+}
+
+struct Posting
+{
+    int id;
+    int tf;
+};
+
+static int compare_posting(const void* a, const void* b)
+{
+    return ((const Posting*)a)->id - ((const Posting*)b)->id;
+}
+
+// Renumber documents (newid[old] = new) and restore ascending order
+void Postings::remap(const int* newid)
+{
+    if(bitmap != NULL){
+        ids = (int*)malloc((count > 0 ? count : 1)*sizeof(int));
+        bitmap->decode(ids);
+        delete bitmap;  // stale under the new ids
+        bitmap = NULL;
+    }
+    Posting* pairs = (Posting*)malloc((count > 0 ? count : 1)*sizeof(Posting));
+    for(int i = 0; i < count; i++){
+        pairs[i].id = newid[ids[i]];
+        pairs[i].tf = tfs[i];
+    }
+    qsort(pairs, count, sizeof(Posting), compare_posting);
+    for(int i = 0; i < count; i++){
+        ids[i] = pairs[i].id;
+        tfs[i] = pairs[i].tf;
+    }
+    free(pairs);
+    for(int i = 0; i < impact_count; i++){
+        impact_ids[i] = newid[impact_ids[i]];
+    }
+}
+
+// Binary search: ids are ascending because documents are indexed in
+// order (a bitmap counts the bits before docId instead). Index of docId
+// in the list, -1 if it is not there.
+int Postings::position(int docId) const
+{
+    if(bitmap != NULL)
+        return docId < bitmap->get_size() && bitmap->test(docId) ? bitmap->rank(docId) : -1;
+    int low = 0, high = count - 1;
+    while(low <= high){
+        int mid = low + (high - low) / 2;
+        if(ids[mid] == docId)
+            return mid;
+        if(ids[mid] < docId)
+            low = mid + 1;
+        else
+            high = mid - 1;
+    }
+    return -1;
+}
+
+// Term frequency of docId, 0 if the word is not in it
+int Postings::search(int docId) const
+{
+    int i = position(docId);
+    return i >= 0 ? tfs[i] : 0;
+}
@@ -0,0 +1,252 @@
+#include "Reorder.hpp"
+#include "Document_store.hpp"
+#include "Kernels.hpp"
+#include <cmath>
+using namespace std;
+
+const int BP_MIN_SIZE = 16;    // Segments smaller than this are left as is
+const int BP_ITERATIONS = 20;  // Swap rounds per split
+
+int parse_reorder(const char* text, ReorderMode* mode)
+{
+    if(!strcmp(text, "text"))
+        *mode = REORDER_TEXT;
+    else if(!strcmp(text, "bp"))
+        *mode = REORDER_BP;
+    else if(!strcmp(text, "none"))
+        *mode = REORDER_NONE;
+    else
+        return -1;
+    return 1;
+}
+
+// Growable array of every Postings in a trie
+struct PostingsList
+{
+    Postings** items;
+    int count;
+    int capacity;
+};
+
+static void collect_postings(const char*, Postings* postings, void* arg)
+{
+    PostingsList* list = (PostingsList*)arg;
+    if(list->count == list->capacity){
+        list->capacity = list->capacity > 0 ? list->capacity * 2 : 1024;
+        list->items = (Postings**)realloc(list->items, list->capacity*sizeof(Postings*));
+    }
+    list->items[list->count++] = postings;
+}
+
+static void collect(TrieNode* trie, Mymap* map, PostingsList* list)
+{
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+    char* buffer = (char*)malloc((map->get_buffersize() + 2)*sizeof(char));
+    trie->visit(buffer, 0, collect_postings, list);
+    free(buffer);
+}
+
+static long gap_bytes(PostingsList* list)
+{
+    long bytes = 0;
+    for(int i = 0; i < list->count; i++){
+        bytes += varint_size(list->items[i]->get_ids(), list->items[i]->get_count());
+    }
+    return bytes;
+}
+
+// ------------------------------------------------------------ text sort
+
+static Mymap* sortmap;  // qsort has no context argument
+
+static int compare_text(const void* a, const void* b)
+{
+    int x = *(const int*)a, y = *(const int*)b;
+    int cmp = strcmp(sortmap->getDocument(x), sortmap->getDocument(y));
+    return cmp != 0 ? cmp : x - y;
+}
+
+// ---------------------------------------------------- graph bisection
+
+struct BpState
+{
+    int* docstart;   // forward index: words of doc d are
+    int* docterms;   // docterms[docstart[d] .. docstart[d+1])
+    int* degA;       // per word: documents of the left half containing it
+    int* degB;
+    double* lg;      // lg[x] = log2(x)
+    int* order;
+};
+
+struct BpEntry
+{
+    double gain;
+    int doc;
+};
+
+static int compare_gain(const void* a, const void* b)
+{
+    double x = ((const BpEntry*)a)->gain, y = ((const BpEntry*)b)->gain;
+    if(x != y)
+        return x > y ? -1 : 1;
+    return ((const BpEntry*)a)->doc - ((const BpEntry*)b)->doc;
+}
+
+// Estimated bits for the gaps of a word with deg documents in n
+static inline double bp_cost(BpState* s, int deg, int n)
+{
+    return deg * (s->lg[n] - s->lg[deg + 1]);
+}
+
+static void bp_degrees(BpState* s, int lo, int hi, int* deg, int delta)
+{
+    for(int i = lo; i < hi; i++){
+        int d = s->order[i];
+        for(int t = s->docstart[d]; t < s->docstart[d + 1]; t++)
+            deg[s->docterms[t]] += delta;
+    }
+}
+
+// Gain of moving each document of one half to the other
+static void bp_gains(BpState* s, int lo, int hi, int* from, int nfrom, int* to, int nto, BpEntry* out)
+{
+    for(int i = lo; i < hi; i++){
+        int d = s->order[i];
+        double gain = 0;
+        for(int t = s->docstart[d]; t < s->docstart[d + 1]; t++){
+            int w = s->docterms[t];
+            gain += bp_cost(s, from[w], nfrom) + bp_cost(s, to[w], nto)
+                  - bp_cost(s, from[w] - 1, nfrom) - bp_cost(s, to[w] + 1, nto);
+        }
+        out[i - lo].gain = gain;
+        out[i - lo].doc = d;
+    }
+}
+
+static void bp_split(BpState* s, int lo, int hi, BpEntry* left, BpEntry* right)
+{
+    int n = hi - lo;
+    if(n < BP_MIN_SIZE)
+        return;
+    int mid = lo + n / 2;
+    int n1 = mid - lo, n2 = hi - mid;
+    for(int iter = 0; iter < BP_ITERATIONS; iter++){
+        bp_degrees(s, lo, mid, s->degA, 1);
+        bp_degrees(s, mid, hi, s->degB, 1);
+        bp_gains(s, lo, mid, s->degA, n1, s->degB, n2, left);
+        bp_gains(s, mid, hi, s->degB, n2, s->degA, n1, right);
+        bp_degrees(s, lo, mid, s->degA, -1);
+        bp_degrees(s, mid, hi, s->degB, -1);
+
+        qsort(left, n1, sizeof(BpEntry), compare_gain);
+        qsort(right, n2, sizeof(BpEntry), compare_gain);
+        int swaps = 0;
+        while(swaps < n1 && swaps < n2 && left[swaps].gain + right[swaps].gain > 0){
+            int doc = left[swaps].doc;
+            left[swaps].doc = right[swaps].doc;
+            right[swaps].doc = doc;
+            swaps++;
+        }
+        for(int i = 0; i < n1; i++)
+            s->order[lo + i] = left[i].doc;
+        for(int i = 0; i < n2; i++)
+            s->order[mid + i] = right[i].doc;
+        if(swaps == 0)
+            break;
+    }
+    bp_split(s, lo, mid, left, right);
+    bp_split(s, mid, hi, left, right);
+}
+
+static void bp_order(PostingsList* list, int N, int* order)
+{
+    BpState s;
+    s.order = order;
+    s.docstart = (int*)calloc(N + 1, sizeof(int));
+    long total = 0;
+    for(int i = 0; i < list->count; i++){
+        const int* ids = list->items[i]->get_ids();
+        for(int p = 0; p < list->items[i]->get_count(); p++)
+            s.docstart[ids[p] + 1]++;
+        total += list->items[i]->get_count();
+    }
+    for(int d = 0; d < N; d++)
+        s.docstart[d + 1] += s.docstart[d];
+    s.docterms = (int*)malloc((total > 0 ? total : 1)*sizeof(int));
+    int* fill = (int*)malloc((N > 0 ? N : 1)*sizeof(int));
+    memcpy(fill, s.docstart, N*sizeof(int));
+    for(int i = 0; i < list->count; i++){
+        const int* ids = list->items[i]->get_ids();
+        for(int p = 0; p < list->items[i]->get_count(); p++)
+            s.docterms[fill[ids[p]]++] = i;
+    }
+    free(fill);
+    s.degA = (int*)calloc(list->count > 0 ? list->count : 1, sizeof(int));
+    s.degB = (int*)calloc(list->count > 0 ? list->count : 1, sizeof(int));
+    s.lg = (double*)malloc((N + 2)*sizeof(double));
+    s.lg[0] = 0;
+    for(int x = 1; x < N + 2; x++)
+        s.lg[x] = log2((double)x);
+
+    BpEntry* left = (BpEntry*)malloc((N / 2 + 1)*sizeof(BpEntry));
+    BpEntry* right = (BpEntry*)malloc((N / 2 + 1)*sizeof(BpEntry));
+    bp_split(&s, 0, N, left, right);
+
+    free(left);
+    free(right);
+    free(s.lg);
+    free(s.degA);
+    free(s.degB);
+    free(s.docterms);
+    free(s.docstart);
+}
+
+// ---------------------------------------------------------------- apply
+
+void reorder_documents(TrieNode* trie, TrieNode* titles, TrieNode* pairs, Mymap* map, ReorderMode mode)
+{
+    if(mode == REORDER_NONE){
+        return;
+    }
+    int N = map->get_size();
+    PostingsList list;
+    collect(trie, map, &list);
+    long before = gap_bytes(&list);
+
+    int* order = (int*)malloc((N > 0 ? N : 1)*sizeof(int));
+    for(int i = 0; i < N; i++)
+        order[i] = i;
+    if(mode == REORDER_TEXT){
+        sortmap = map;
+        qsort(order, N, sizeof(int), compare_text);
+    }
+    else{
+        bp_order(&list, N, order);
+    }
+
+    int* newid = (int*)malloc((N > 0 ? N : 1)*sizeof(int));
+    for(int i = 0; i < N; i++)
+        newid[order[i]] = i;
+    map->reorder(order);
+    for(int i = 0; i < list.count; i++)
+        list.items[i]->remap(newid);
+    TrieNode* fields[2] = {titles, pairs};  // title postings, bigram postings
+    for(int f = 0; f < 2; f++){
+        if(fields[f] == NULL)
+            continue;
+        PostingsList fieldlist;
+        collect(fields[f], map, &fieldlist);
+        for(int i = 0; i < fieldlist.count; i++)
+            fieldlist.items[i]->remap(newid);
+        free(fieldlist.items);
+    }
+    long after = gap_bytes(&list);
+    build_log() << "Reordered " << N << " documents (" << (mode == REORDER_TEXT ? "text" : "bp")
+         << "): docid gaps " << before << " -> " << after << " bytes as varints" << endl;
+
+    free(newid);
+    free(order);
+    free(list.items);
+}
@@ -0,0 +1,202 @@
+#include "ResultWriter.hpp"
+#include <cerrno>
+#ifdef _WIN32
+    #include <io.h>
+#else
+    #include <unistd.h>
+#endif
+using namespace std;
+
+const int SNIPPET_BEFORE = 5;     // Words kept before the first match
+const int SNIPPET_WORDS = 20;     // Words per snippet
+const size_t SNIPPET_CHARS = 240; // Hard cap for very long words
+const size_t TITLE_CHARS = 100;   // Header title cap outside full mode
+
+int parse_output(const char* text, OutputMode* mode)
+{
+    if(!strcmp(text, "full"))
+        *mode = OUTPUT_FULL;
+    else if(!strcmp(text, "title"))
+        *mode = OUTPUT_TITLE;
+    else if(!strcmp(text, "snippet"))
+        *mode = OUTPUT_SNIPPET;
+    else if(!strcmp(text, "ids"))
+        *mode = OUTPUT_IDS;
+    else
+        return -1;
+    return 1;
+}
+
+ResultWriter::ResultWriter(OutputMode mode) : buffer(NULL), length(0), capacity(0), mode(mode)
+{
+    reserve(4096);
+}
+
+ResultWriter::~ResultWriter()
+{
+    free(buffer);
+}
+
+void ResultWriter::reserve(size_t extra)
+{
+    if(length + extra <= capacity)
+        return;
+    size_t newcapacity = capacity > 0 ? capacity : 4096;
+    while(newcapacity < length + extra)
+        newcapacity *= 2;
+    buffer = (char*)realloc(buffer, newcapacity);
+    capacity = newcapacity;
+}
+
+void ResultWriter::append(const char* text, size_t len)
+{
+    reserve(len);
+    memcpy(buffer + length, text, len);
+    length += len;
+}
+
+void ResultWriter::append(const char* text)
+{
+    append(text, strlen(text));
+}
+
+// A window of words starting a little before the first query word
+static int is_space(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+void ResultWriter::snippet(const char* document, const char* const* words, int nwords)
+{
+    // Find the word index of the first token equal to a query word
+    int match = 0, index = 0;
+    for(const char* p = document; *p != '\0'; ){
+        while(is_space(*p))
+            p++;
+        if(*p == '\0')
+            break;
+        const char* end = p;
+        while(*end != '\0' && !is_space(*end))
+            end++;
+        int found = 0;
+        for(int w = 0; w < nwords && !found; w++){
+            size_t len = strlen(words[w]);
+            found = (size_t)(end - p) == len && !strncmp(p, words[w], len);
+        }
+        if(found){
+            match = index;
+            break;
+        }
+        index++;
+        p = end;
+    }
+    int first = match > SNIPPET_BEFORE ? match - SNIPPET_BEFORE : 0;
+
+    // Skip to the first word of the window, then copy up to the limits
+    const char* p = document;
+    for(int skipped = 0; ; skipped++){
+        while(is_space(*p))
+            p++;
+        if(skipped == first || *p == '\0')
+            break;
+        while(*p != '\0' && !is_space(*p))
+            p++;
+    }
+    if(first > 0)
+        append("... ", 4);
+    const char* start = p;
+    int count = 0;
+    while(*p != '\0' && count < SNIPPET_WORDS && (size_t)(p - start) < SNIPPET_CHARS){
+        while(*p != '\0' && !is_space(*p))
+            p++;
+        count++;
+        while(is_space(*p) && count < SNIPPET_WORDS)
+            p++;
+    }
+    size_t len = (size_t)(p - start);
+    if(len > SNIPPET_CHARS)
+        len = SNIPPET_CHARS;
+    while(len > 0 && is_space(start[len - 1]))
+        len--;
+    append(start, len);
+    if(start[len] != '\0')
+        append(" ...", 4);
+    append("\n", 1);
+}
+
+void ResultWriter::add(int id, double score, const char* document, const char* const* words, int nwords)
+{
+    char number[64];
+    if(mode == OUTPUT_IDS){
+        int n = snprintf(number, sizeof(number), "%d %g\n", id, score);
+        append(number, n);
+        return;
+    }
+    // Header: [line] Title score=X. Full mode keeps the original header,
+    // the whole first line; the others show the title (text before the
+    // first tab), cut at TITLE_CHARS.
+    int n = snprintf(number, sizeof(number), "[%d] ", id);
+    append(number, n);
+    if(mode == OUTPUT_FULL){
+        const char* first = document + strspn(document, "\n");
+        append(first, strcspn(first, "\n"));
+    }
+    else{
+        const char* tab = strchr(document, '\t');
+        size_t titlelen = tab != NULL ? (size_t)(tab - document) : strlen(document);
+        if(titlelen > TITLE_CHARS){
+            append(document, TITLE_CHARS);
+            append("...", 3);
+        }
+        else{
+            append(document, titlelen);
+        }
+    }
+    n = snprintf(number, sizeof(number), " score=%g\n", score);
+    append(number, n);
+    if(mode == OUTPUT_FULL){
+        append(document);
+        append("\n", 1);
+    }
+    else if(mode == OUTPUT_SNIPPET){
+        snippet(document, words, nwords);
+    }
+}
+
+void ResultWriter::separator()
+{
+    if(mode != OUTPUT_IDS)
+        append("---\n", 4);
+}
+
+void ResultWriter::line(const char* text)
+{
+    append(text);
+    append("\n", 1);
+}
+
+// Writes everything buffered so far and empties the buffer.
+// Anything still sitting in cout/stdout (the prompt) goes out first.
+int ResultWriter::flush()
+{
+    cout.flush();
+    fflush(stdout);
+    size_t done = 0;
+    while(done < length){
+#ifdef _WIN32
+        int written = _write(1, buffer + done, (unsigned int)(length - done));
+#else
+        ssize_t written = write(STDOUT_FILENO, buffer + done, length - done);
+#endif
+        if(written < 0 && errno == EINTR){
+            continue;  // interrupted by a signal before anything was written
+        }
+        if(written <= 0){
+            length = 0;
+            return -1;
+        }
+        done += (size_t)written;
+    }
+    length = 0;
+    return 1;
+}
@@ -0,0 +1,27 @@
+#include "Scorer.hpp"
+using namespace std;
+
+int parse_scorer(const char* name, ScorerType* type)
+{
+    if(!strcmp(name, "bm25"))
+        *type = SCORER_BM25;
+    else if(!strcmp(name, "bm25plus"))
+        *type = SCORER_BM25PLUS;
+    else if(!strcmp(name, "tfidf"))
+        *type = SCORER_TFIDF;
+    else if(!strcmp(name, "bm25f"))
+        *type = SCORER_BM25F;
+    else
+        return -1;
+    return 1;
+}
+
+const char* scorer_name(ScorerType type)
+{
+    switch(type){
+        case SCORER_BM25PLUS: return "bm25plus";
+        case SCORER_TFIDF:    return "tfidf";
+        case SCORER_BM25F:    return "bm25f";
+        default:              return "bm25";
+    }
+}
@@ -1,91 +1,383 @@
 #include "Search.hpp"
 using namespace std;
-const float k1=1.2;
-const float b=0.75;
-const int MAX_QUERY_WORDS = 10;  // Maximum search terms in one query
+static ScorerType scorer = SCORER_BM25;
+static ScorerParams params = {1.2f, 0.75f};
+static ResultWriter writer(OUTPUT_FULL);  // reused by every /search
+const int MAX_QUERY_WORDS = PLAN_MAX_TERMS;  // Maximum search terms in one query
 const int MAX_WORDS_STORAGE = 100;  // Storage array size
 const int MAX_WORD_LENGTH = 256;  // Maximum length per word
 
-void search(char *token, TrieNode *trie, Mymap *map, int k)
+const int FILTER_BLOCK = 256;  // Scores checked per threshold refresh
+const int MAX_PAGE_SIZE = 1000;  // Largest page=<n>; deeper results come through after=
+const int CURSOR_LENGTH = 32;    // 8 hex digits of the snapshot id, 16 of the score's bits, 8 of the docid
+
+// Page of /search results: how many hits and where the previous page ended
+struct PageRequest
 {
-    char queryWords[MAX_WORDS_STORAGE][MAX_WORD_LENGTH];
-    double IDF[MAX_WORDS_STORAGE];
-    
-    token = strtok(NULL, " \t\n");
-    if(token == NULL){
-        cout << "Error: Please enter search terms" << endl;
-        return;
+    int size;
+    SearchAfter after;
+    unsigned int snapshot;  // index the cursor was made on
+    int paged;              // page= or after= given
+};
+
+// Norms are computed per snapshot by build_snapshot()
+void search_init(ScorerType type, ScorerParams p)
+{
+    scorer = type;
+    params = p;
+}
+
+void search_set_output(OutputMode mode)
+{
+    writer.set_mode(mode);
+}
+
+// Term-at-a-time evaluator, instantiated once per ranking policy.
+// Adds every kept word's weights (rarest first) into the dense
+// accumulator acc and returns the number of candidates (kept in
+// first-seen order).
+template <class Scorer>
+static int accumulate(const QueryPlan *plan, const TermContext &base,
+                      double *acc, char *seen, int *candidates)
+{
+    int longest = 0;
+    for(int l=0;l<plan->nkept;l++){
+        if(plan->terms[plan->order[l]].df > longest){
+            longest = plan->terms[plan->order[l]].df;
+        }
     }
-    
-    Scorelist* scorelist = new Scorelist();
+
+    TermContext context = base;
+    double *weights = (double*)malloc((longest > 0 ? longest : 1)*sizeof(double));
+    int *decoded = (int*)malloc((longest > 0 ? longest : 1)*sizeof(int));  // a bitmap word's ids
+    int numCandidates = 0;
+    for(int l=0;l<plan->nkept;l++){
+        const PlanTerm *term = &plan->terms[plan->order[l]];
+        const int* ids = term->body->decode_ids(decoded);
+        context.body = term->body;
+        context.ids = ids;
+        context.title = term->title;
+        Scorer::weights(context, term->weight, weights);
+        int count = term->df;
+        for(int p=0;p<count;p++){
+            if(!seen[ids[p]]){
+                seen[ids[p]] = 1;
+                candidates[numCandidates++] = ids[p];
+            }
+            acc[ids[p]] += weights[p];
+        }
+    }
+    free(decoded);
+    free(weights);
+    return numCandidates;
+}
+
+// The cursor printed after a page: the id of the snapshot it was made on
+// (a /reload renumbers documents), the last hit's score (bit for bit, so
+// the threshold is exact) and internal docid. Only meaningful for the
+// same query.
+static void encode_cursor(SearchAfter after, unsigned int snapshot, char *text)
+{
+    unsigned long long bits;
+    memcpy(&bits, &after.score, sizeof(bits));
+    snprintf(text, CURSOR_LENGTH + 1, "%08x%016llx%08x", snapshot, bits, (unsigned int)after.id);
+}
+
+static int decode_cursor(const char *text, SearchAfter *after, unsigned int *snapshot)
+{
+    if(strlen(text) != CURSOR_LENGTH){
+        return -1;
+    }
+    for(int c=0;c<CURSOR_LENGTH;c++){
+        if(!isxdigit((unsigned char)text[c])){
+            return -1;
+        }
+    }
+    char part[17];
+    memcpy(part, text, 8);
+    part[8] = '\0';
+    *snapshot = (unsigned int)strtoul(part, NULL, 16);
+    memcpy(part, text + 8, 16);
+    part[16] = '\0';
+    unsigned long long bits = strtoull(part, NULL, 16);
+    memcpy(&after->score, &bits, sizeof(bits));
+    unsigned long id = strtoul(text + 24, NULL, 16);
+    if(id > 0x7fffffffUL || after->score != after->score){
+        return -1;
+    }
+    after->id = (int)id;
+    return 1;
+}
+
+// Reads up to MAX_QUERY_WORDS words following the command. With page
+// set, leading page=<n> and after=<cursor> options are taken first;
+// returns -1 if one of them is malformed.
+static int parse_query(char queryWords[][MAX_WORD_LENGTH], PageRequest *page = NULL)
+{
     int i;
+    char *token = strtok(NULL, " \t\n");
+    while(page != NULL && token != NULL){
+        if(!strncmp(token, "page=", 5)){
+            char *end;
+            long size = strtol(token + 5, &end, 10);
+            if(end == token + 5 || *end != '\0' || size < 1 || size > MAX_PAGE_SIZE){
+                cout << "Error: page must be between 1 and " << MAX_PAGE_SIZE << endl;
+                return -1;
+            }
+            page->size = (int)size;
+            page->paged = 1;
+        } else if(!strncmp(token, "after=", 6)){
+            page->paged = 1;
+            if(decode_cursor(token + 6, &page->after, &page->snapshot) == -1){
+                cout << "Error: Invalid cursor '" << token + 6 << "'" << endl;
+                return -1;
+            }
+        } else {
+            break;
+        }
+        token = strtok(NULL, " \t\n");
+    }
     for(i=0; i<MAX_QUERY_WORDS; i++){
         if(token == NULL){
             break;
         }
-        strcpy(queryWords[i], token);
-        int wordlen = strlen(queryWords[i]);
-        double df = (double)trie->dfsearchword(queryWords[i],0,wordlen);
-        double N = (double)map->get_size();
-        // IDF formula: log((N - df + 0.5) / (df + 0.5))
-        // Add safety check to prevent log of negative or zero
-        if(df == 0){
-            IDF[i] = log((N + 1.0) / 1.0);  // Word not found, maximum IDF
-        } else {
-            IDF[i] = log((N - df + 0.5) / (df + 0.5));
+        size_t length = strlen(token);
+        if(length >= (size_t)MAX_WORD_LENGTH){
+            length = MAX_WORD_LENGTH - 1;  // longer words are cut, as the planner does
         }
-        trie->search(queryWords[i],0,scorelist);
+        memcpy(queryWords[i], token, length);
+        queryWords[i][length] = '\0';
         token = strtok(NULL, " \t\n");
     }
-    
-    // Check if any words were parsed
-    if(i == 0){
-        cout << "Error: Please enter valid search terms" << endl;
-        delete scorelist;
-        return;
+    return i;
+}
+
+// Fills acc for a dense or impact plan and returns the number of candidates
+static int score_query(const QueryPlan *plan, const TermContext &base, int k, int N,
+                       double *acc, char *seen, int *candidates, EvalCounters *counters)
+{
+    if(plan->strategy == PLAN_IMPACT){
+        Postings* postings[MAX_QUERY_WORDS];
+        for(int l=0;l<plan->nkept;l++){
+            postings[l] = plan->terms[plan->order[l]].body;
+        }
+        int *slots = (int*)malloc((N > 0 ? N : 1)*sizeof(int));  // never read before written
+        int numCandidates = impact_accumulate(postings, plan->nkept, k, acc, seen, candidates, slots,
+                                              &counters->scored);
+        free(slots);
+        return numCandidates;
     }
-    double avgdl=0;
-    for(int m=0; m<map->get_size(); m++){
-        avgdl+=(double)map->getlength(m);
+    counters->scored = plan->postings;
+    switch(scorer){
+        case SCORER_BM25PLUS:
+            return accumulate<BM25Plus>(plan, base, acc, seen, candidates);
+        case SCORER_TFIDF:
+            return accumulate<TfIdf>(plan, base, acc, seen, candidates);
+        case SCORER_BM25F:
+            return accumulate<BM25F>(plan, base, acc, seen, candidates);
+        default:
+            return accumulate<BM25>(plan, base, acc, seen, candidates);
     }
-    if(map->get_size() > 0){
-        avgdl/=(double)map->get_size();
+}
+
+// Pushes the candidates into heap. Scores are gathered first so the
+// filter kernel can skip every entry that cannot beat the k-th best.
+static void select_topk(const double *acc, const int *candidates, int numCandidates, const QueryPlan *plan,
+                        Maxheap *heap)
+{
+    double *scores = (double*)malloc((numCandidates > 0 ? numCandidates : 1)*sizeof(double));
+    int *passed = (int*)malloc(FILTER_BLOCK*sizeof(int));
+    for(int c=0;c<numCandidates;c++){
+        scores[c] = acc[candidates[c]];
     }
-    if(avgdl == 0){
-        avgdl = 1.0;  // Prevent division by zero
+    if(plan->filter != NULL){
+        for(int c=0;c<numCandidates;c++){
+            if(!plan->filter->test(candidates[c])){
+                scores[c] = -HUGE_VAL;  // ruled out by +word/-word
+            }
+        }
     }
-    
-    double score=0;
-    Scorelist* currentDoc=scorelist;
-    //maxheap
-    int resultCount = 0;
-    Maxheap* heap=new Maxheap(k);
+    if(plan->after.id >= 0){
+        for(int c=0;c<numCandidates;c++){
+            if(!plan_admits(plan, scores[c], candidates[c])){
+                scores[c] = -HUGE_VAL;  // on an earlier page
+            }
+        }
+    }
+    for(int start=0; start<numCandidates; start+=FILTER_BLOCK){
+        int len = numCandidates - start < FILTER_BLOCK ? numCandidates - start : FILTER_BLOCK;
+        // Candidates are not in docid order: one tying the k-th score
+        // may still rank above it
+        double threshold = nextafter(heap->get_min(), -HUGE_VAL);
+        int kept = filter_above(scores + start, len, threshold, passed);
+        for(int p=0;p<kept;p++){
+            heap->insert(scores[start + passed[p]], candidates[start + passed[p]]);
+        }
+    }
+    free(passed);
+    free(scores);
+}
 
-    while(currentDoc!=NULL){
-        if(currentDoc->get_id() != -1){  // Skip empty placeholder node
-            score = 0;
-            for(int l=0;l<i;l++){
-                int wordlen = strlen(queryWords[l]);
-                double tf = (double)trie->tfsearchword(currentDoc->get_id(),queryWords[l],0,wordlen);
-                if(tf > 0){  // Only calculate if term exists in document
-                    double doclen = (double)map->getlength(currentDoc->get_id());
-                    double bm25_tf = (tf * (k1 + 1.0)) / (tf + k1 * (1.0 - b + b * (doclen / avgdl)));
-                    score += IDF[l] * bm25_tf;
-                }
+// Scores each of docs from the full postings, adding the words in the
+// order accumulate() does so the sum matches a dense run bit for bit
+template <class Scorer>
+static void exact_scores(const QueryPlan *plan, const TermContext &base, const int *docs, int n,
+                         double *acc)
+{
+    TermContext context = base;
+    for(int c=0;c<n;c++){
+        double score = 0;
+        for(int l=0;l<plan->nkept;l++){
+            const PlanTerm *term = &plan->terms[plan->order[l]];
+            int pos = term->body->position(docs[c]);
+            if(pos < 0){
+                continue;
             }
-            heap->insert(score, currentDoc->get_id());
-            resultCount++;
+            context.body = term->body;
+            context.title = term->title;
+            score += Scorer::score(context, term->weight, pos, docs[c]);
         }
-        currentDoc=currentDoc->get_next();
+        acc[docs[c]] = score;
+    }
+}
+
+// An impact run fixes the top-k set but leaves partial sums (it stops
+// early, and -impact may have pruned postings), so its best k are scored
+// again exactly: one seek per word each. They become the only candidates;
+// returns how many there are.
+static int rescore_survivors(const QueryPlan *plan, const TermContext &base, int k, double *acc,
+                             int *candidates, int numCandidates, EvalCounters *counters)
+{
+    Maxheap survivors(k);
+    select_topk(acc, candidates, numCandidates, plan, &survivors);
+    int n = 0;
+    while(survivors.get_count() > 0){
+        candidates[n++] = survivors.get_id();
+        survivors.remove();
     }
-    if(resultCount>k){
-        resultCount=k;
+    counters->probes += (long)n * plan->nkept;
+    switch(scorer){
+        case SCORER_BM25PLUS:
+            exact_scores<BM25Plus>(plan, base, candidates, n, acc);
+            break;
+        case SCORER_TFIDF:
+            exact_scores<TfIdf>(plan, base, candidates, n, acc);
+            break;
+        case SCORER_BM25F:
+            exact_scores<BM25F>(plan, base, candidates, n, acc);
+            break;
+        default:
+            exact_scores<BM25>(plan, base, candidates, n, acc);
+            break;
     }
+    return n;
+}
+
+// plan_query() over snapshot with the scorer search_init() set
+void plan_words(QueryPlan *plan, const char* const* words, int nwords, Snapshot *snapshot, int k, SearchAfter after)
+{
+    plan_query(plan, words, nwords, snapshot->get_trie(), snapshot->get_titles(), snapshot->get_bigrams(),
+               snapshot->get_map(), scorer, k, snapshot->uses_impacts(), after);
+}
+
+// impacts = 0 keeps the plan off the -impact lists
+static void make_plan(QueryPlan *plan, char queryWords[][MAX_WORD_LENGTH], int nwords, Snapshot *snapshot, int k,
+                      SearchAfter after, int impacts = 1)
+{
+    const char* words[MAX_QUERY_WORDS];
+    for(int l=0;l<nwords;l++){
+        words[l] = queryWords[l];
+    }
+    plan_query(plan, words, nwords, snapshot->get_trie(), snapshot->get_titles(), snapshot->get_bigrams(),
+               snapshot->get_map(), scorer, k, impacts && snapshot->uses_impacts(), after);
+}
+
+// Runs plan and leaves its top k in heap. Returns the strategy that
+// produced it (a conjunctive plan may fall back to wand).
+PlanStrategy run_query(const QueryPlan *plan, Snapshot *snapshot, int k, Maxheap *heap,
+                       EvalCounters *counters)
+{
+    Mymap *map = snapshot->get_map();
+    TermContext base;
+    base.body = NULL;
+    base.ids = NULL;
+    base.title = NULL;
+    base.norms = map->get_norms();
+    base.title_norms = map->get_title_norms();
+    base.body_norms = map->get_body_norms();
+    base.params = params;
+    counters->scored = 0;
+    counters->probes = 0;
+    if(plan->strategy != PLAN_DENSE && plan->strategy != PLAN_IMPACT){
+        return daat_evaluate(plan, scorer, base, heap, counters);
+    }
+    int N = map->get_size();
+    double *acc = (double*)calloc(N > 0 ? N : 1, sizeof(double));
+    char *seen = (char*)calloc(N > 0 ? N : 1, sizeof(char));
+    int *candidates = (int*)malloc((N > 0 ? N : 1)*sizeof(int));
+    int numCandidates = score_query(plan, base, k, N, acc, seen, candidates, counters);
+    if(plan->strategy == PLAN_IMPACT){
+        numCandidates = rescore_survivors(plan, base, k, acc, candidates, numCandidates, counters);
+    }
+    select_topk(acc, candidates, numCandidates, plan, heap);
+    free(candidates);
+    free(seen);
+    free(acc);
+    return plan->strategy;
+}
+
+// /search [page=<n>] [after=<cursor>] <query>: one page of n hits (k by
+// default). A full page ends with the cursor of its last hit; passing it
+// back ranks only the hits after it, so a deep page costs what the first
+// one does instead of a heap holding every earlier hit. Paged searches
+// never use the -impact lists: a pruned list can leave a document out of
+// the top k, and the next page must continue from the exact ranking. A
+// plain search ranked from them ends without a cursor.
+void search(char *, Snapshot *snapshot, int k)
+{
+    Mymap *map = snapshot->get_map();
+    char queryWords[MAX_WORDS_STORAGE][MAX_WORD_LENGTH];
+    PageRequest page;
+    page.size = k;
+    page.after = FIRST_PAGE;
+    page.snapshot = 0;
+    page.paged = 0;
     
-    // Display top k results from heap
+    int i = parse_query(queryWords, &page);
+    if(i == -1){
+        return;
+    }
+    if(i == 0){
+        cout << "Error: Please enter search terms" << endl;
+        return;
+    }
+    if(page.after.id >= 0 && page.snapshot != snapshot->get_id()){
+        cout << "Error: The cursor is from an index that has been rebuilt since; search again from the first page" << endl;
+        return;
+    }
+    k = page.size;
+    
+    QueryPlan plan;
+    make_plan(&plan, queryWords, i, snapshot, k, page.after, !page.paged);
+    EvalCounters counters;
+    Maxheap* heap=new Maxheap(k);
+    PlanStrategy ran = run_query(&plan, snapshot, k, heap, &counters);
+    release_plan(&plan);
+    
+    // Format the whole page into the writer, then one write
+    // (snippets look for the words without their +/- and skip -words)
+    const char* words[MAX_WORDS_STORAGE];
+    int nmatch = 0;
+    for(int l=0;l<plan.nterms;l++){
+        if(plan.terms[l].status != TERM_EXCLUDED){
+            words[nmatch++] = plan.terms[l].word;
+        }
+    }
+    writer.clear();
     int actualResults = heap->get_count();
+    SearchAfter last = page.after;
     if(actualResults == 0){
-        cout << "No documents found matching the query." << endl;
+        writer.line(page.after.id >= 0 ? "No more results." : "No documents found matching the query.");
     } else {
         for(int j = 0; j < actualResults; j++){
             if(heap->get_count() == 0){
@@ -100,6 +392,8 @@ void search(char *token, TrieNode *trie, Mymap *map, int k)
             
             double docScore = heap->get_score();
             heap->remove();
+            last.score = docScore;
+            last.id = docId;
             
             // Get document content
             const char *fullDoc = map->getDocument(docId);
@@ -107,40 +401,28 @@ void search(char *token, TrieNode *trie, Mymap *map, int k)
                 continue;  // Skip if document not found
             }
             
-            // Print header: [docId] Document Title score=X.XXXXXX
-            cout << "[" << docId << "] ";
-            
-            // Extract first line as title
-            char *line = (char*)malloc(map->get_buffersize()*sizeof(char));
-            if(line == NULL){
-                cout << " score=" << docScore << endl;
-                cout << fullDoc << endl;
-                if(j < actualResults - 1){
-                    cout << "---" << endl;
-                }
-                continue;
-            }
-            
-            strcpy(line, fullDoc);
-            char *firstLine = strtok(line, "\n");
-            if(firstLine != NULL){
-                cout << firstLine;
-            }
-            cout << " score=" << docScore << endl;
-            free(line);
-            
-            // Print the full document content
-            cout << fullDoc << endl;
+            writer.add(map->original_id(docId), docScore, fullDoc, words, nmatch);
             
             // Print separator
             if(j < actualResults - 1){
-                cout << "---" << endl;
+                writer.separator();
             }
         }
     }
+    if(actualResults == k){
+        char cursor[CURSOR_LENGTH + 1];
+        char next[CURSOR_LENGTH + 96];
+        if(ran == PLAN_IMPACT){
+            snprintf(next, sizeof(next), "More results: search with page=%d to page through them", k);
+        } else {
+            encode_cursor(last, snapshot->get_id(), cursor);
+            snprintf(next, sizeof(next), "Next page: page=%d after=%s", k, cursor);
+        }
+        writer.line(next);
+    }
+    writer.flush();
     
     delete heap;
-    delete scorelist;
 }
 
 void df(TrieNode *trie)
@@ -167,7 +449,7 @@ void df(TrieNode *trie)
     }
 }
 
-int tf(char *token, TrieNode *trie)
+int tf(char *, TrieNode *trie, Mymap *map)
 {
     // Get document ID
     char *token2 = strtok(NULL, " \t\n");
@@ -205,7 +487,9 @@ int tf(char *token, TrieNode *trie)
 
     // Search for the word and get frequency
     int wordlen = strlen(token2);
-    int frequency = trie->tfsearchword(id, token2, 0, wordlen);
+    // id is the input line number; postings use the (possibly reordered) docid
+    int docId = map->internal_id(id);
+    int frequency = docId == -1 ? 0 : trie->tfsearchword(docId, token2, 0, wordlen);
 
     // Display result with clear message
     if (frequency == 0)
@@ -218,4 +502,140 @@ int tf(char *token, TrieNode *trie)
     }
 
     return 0;
+}
+
+// /recall <query>: compares the impact-ordered top k with the exhaustive
+// top k for the same query and reports recall@k and postings touched
+void recall(Snapshot *snapshot, int k)
+{
+    char queryWords[MAX_WORDS_STORAGE][MAX_WORD_LENGTH];
+    int nwords = parse_query(queryWords);
+    if(nwords == 0){
+        cout << "Error: Missing query. Usage: /recall <query>" << endl;
+        return;
+    }
+    if(!snapshot->uses_impacts()){
+        cout << "Impact-ordered postings are off. Start with -impact full|global:<t>|term:<f>" << endl;
+        return;
+    }
+    QueryPlan plan;
+    make_plan(&plan, queryWords, nwords, snapshot, k, FIRST_PAGE);
+    EvalCounters exactCounters, fastCounters;
+    Maxheap exact(k), fast(k);
+    plan.strategy = PLAN_DENSE;
+    run_query(&plan, snapshot, k, &exact, &exactCounters);
+    if(plan.estimates[PLAN_IMPACT] >= 0){
+        plan.strategy = PLAN_IMPACT;
+    }
+    run_query(&plan, snapshot, k, &fast, &fastCounters);
+    release_plan(&plan);
+
+    int total = exact.get_count();
+    int *exactIds = (int*)malloc((total > 0 ? total : 1)*sizeof(int));
+    for(int j=0;j<total;j++){
+        exactIds[j] = exact.get_id();
+        exact.remove();
+    }
+    int hits = 0;
+    while(fast.get_count() > 0){
+        for(int j=0;j<total;j++){
+            if(exactIds[j] == fast.get_id()){
+                hits++;
+                break;
+            }
+        }
+        fast.remove();
+    }
+    free(exactIds);
+    if(total == 0){
+        cout << "No documents found matching the query." << endl;
+        return;
+    }
+    cout << "recall@" << k << " = " << (double)hits / total << " (" << hits << "/" << total << ")"
+         << ", postings scored: " << fastCounters.scored << " of " << exactCounters.scored << endl;
+}
+
+static const char* status_name(TermStatus status)
+{
+    switch(status){
+        case TERM_MISSING: return "not indexed";
+        case TERM_DROPPED: return "dropped (idf <= 0)";
+        case TERM_FLOORED: return "down-weighted";
+        case TERM_EXCLUDED: return "excluded";
+        default:           return "kept";
+    }
+}
+
+// /explain <query>: prints the plan /search would run for the query
+// (per-word df, idf and bound, estimated cost of every strategy), runs
+// it and prints the measured cost next to the estimate
+void explain(Snapshot *snapshot, int k)
+{
+    char queryWords[MAX_WORDS_STORAGE][MAX_WORD_LENGTH];
+    int nwords = parse_query(queryWords);
+    if(nwords == 0){
+        cout << "Error: Missing query. Usage: /explain <query>" << endl;
+        return;
+    }
+    QueryPlan plan;
+    make_plan(&plan, queryWords, nwords, snapshot, k, FIRST_PAGE);
+    int N = snapshot->get_map()->get_size();
+    ios::fmtflags flags = cout.flags();
+    streamsize precision = cout.precision();
+    cout << fixed << setprecision(3);
+    cout << left << setw(16) << "word" << right << setw(10) << "df" << setw(10) << "idf"
+         << setw(10) << "bound" << "  status" << endl;
+    for(int i = 0; i < plan.nkept; i++){
+        const PlanTerm *term = &plan.terms[plan.order[i]];
+        cout << left << setw(16) << term->word << right << setw(10) << term->df << setw(10) << term->idf
+             << setw(10) << term->upper << "  " << status_name(term->status)
+             << (term->required ? ", required" : "")
+             << (term->body->get_bitmap() != NULL ? ", bitmap" : "") << endl;
+    }
+    for(int l = 0; l < plan.nterms; l++){
+        const PlanTerm *term = &plan.terms[l];
+        if(term->status == TERM_KEPT || term->status == TERM_FLOORED){
+            continue;
+        }
+        cout << left << setw(16) << term->word << right << setw(10) << term->df << setw(10) << term->idf
+             << setw(10) << "-" << "  " << status_name(term->status)
+             << (term->required ? ", required" : "") << endl;
+    }
+    for(int p = 0; p < plan.nphrases; p++){
+        const PlanPhrase *phrase = &plan.phrases[p];
+        cout << (phrase->excluded ? "Excluded phrase \"" : "Phrase \"");
+        for(int l = phrase->first; l < phrase->first + phrase->count; l++){
+            cout << (l > phrase->first ? " " : "") << plan.terms[l].word;
+        }
+        cout << "\": " << phrase->documents << " document(s), " << phrase->indexed << " of "
+             << (phrase->count > 1 ? phrase->count - 1 : 0) << " pair(s) from the bigram index, "
+             << phrase->checked << " document text(s) checked" << endl;
+    }
+    if(plan.filter != NULL){
+        cout << "Filter (+/- words, phrases): " << plan.filter->cardinality() << " of " << N << " documents" << endl;
+    }
+    cout << "Estimated cost (postings):";
+    for(int s = 0; s < PLAN_STRATEGIES; s++){
+        if(plan.estimates[s] >= 0){
+            cout << " " << strategy_name((PlanStrategy)s) << "=" << setprecision(0) << plan.estimates[s];
+        }
+    }
+    cout << endl;
+
+    EvalCounters counters;
+    Maxheap heap(k);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    PlanStrategy used = run_query(&plan, snapshot, k, &heap, &counters);
+    double micros = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count() / 1000.0;
+    cout << "Plan: " << strategy_name(plan.strategy);
+    if(used != plan.strategy){
+        cout << " (fell back to " << strategy_name(used) << ": partial matches could still rank)";
+    }
+    cout << ", estimated " << plan.estimates[plan.strategy]
+         << ", actual " << strategy_cost(used, &plan, counters.scored, counters.probes, N)
+         << " (" << counters.scored << " postings scored, " << counters.probes << " skip probes, "
+         << setprecision(1) << micros << " us), " << heap.get_count() << " result(s)" << endl;
+    release_plan(&plan);
+    cout.flags(flags);
+    cout.precision(precision);
 }
\ No newline at end of file
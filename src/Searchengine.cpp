@@ -1,79 +1,185 @@
-#include "Searchengine.hpp"
+#include "searchengine.hpp"
 
 using namespace std;
 
-int inputmanager(char* input, TrieNode* trie, Mymap* mymap, int k){
+int inputmanager(char* input, int k){
     char* token=strtok(input, " \t\n");
     
     if(token == NULL){
         return 0;  // Empty input, continue
     }
+    if(!strcmp(token,"/exit")||!strcmp(token,"/quit")){
+        return 2;  // Signal to exit
+    }
+    if(!strcmp(token,"/reload")){
+        char* path = strtok(NULL, " \t\n");  // none: re-read the current file
+        if(start_reload(path) == -1){
+            cout<<"Reload already in progress"<<endl;
+            return 0;
+        }
+        cout<<"Reloading in the background; queries use the current index until it is ready"<<endl;
+        return 1;
+    }
+    // The command runs on the snapshot current now, even if a reload
+    // publishes a new one meanwhile
+    Snapshot* snapshot = acquire_snapshot();
+    TrieNode* trie = snapshot->get_trie();
+    Mymap* mymap = snapshot->get_map();
+    int ret = 1;
     
     if(!strcmp(token,"/search")){
-        search(token,trie,mymap,k);
-        return 1;
+        search(token,snapshot,k);
     }
     else if(!strcmp(token,"/df")){
         df(trie);
-        return 1;
     }
     else if(!strcmp(token,"/tf")){
-        tf(token,trie);
-        return 1;
+        tf(token,trie,mymap);
     }
-    else if(!strcmp(token,"/exit")||!strcmp(token,"/quit")){
-        return 2;  // Signal to exit
+    else if(!strcmp(token,"/recall")){
+        recall(snapshot,k);
+    }
+    else if(!strcmp(token,"/explain")){
+        explain(snapshot,k);
+    }
+    else if(!strcmp(token,"/stats")){
+        stats(trie,mymap,snapshot->get_bigrams());
+    }
+    else if(!strcmp(token,"/bench")){
+        bench(token,snapshot,k);
     }
     else{
         cout<<"Unknown command: "<<token<<endl;
-        cout<<"Available commands: /search, /df, /tf, /exit, /quit"<<endl;
-        return 0;  // Continue, not exit
+        cout<<"Available commands: /search, /df, /tf, /recall, /explain, /stats, /bench, /reload, /exit, /quit"<<endl;
+        ret = 0;  // Continue, not exit
     }
+    release_snapshot(snapshot);
+    return ret;
 }
 // read document/books/searchengine.md for more information
 int main(int argc, char** argv) {
-    if (argc != 5 ||
-        strcmp(argv[1], "-d") != 0 ||
-        strcmp(argv[3], "-k") != 0) {
-        cout << "Wrong arguments. Usage: -d <file> -k <number>" << endl;
+    const char* usage = "Wrong arguments. Usage: -d <file> -k <number> [-scorer bm25|bm25plus|tfidf|bm25f] [-k1 <float>] [-b <float>] [-impact full|global:<t>|term:<f>] [-reorder text|bp] [-output full|title|snippet|ids] [-batch-memory <MB>] [-bigrams <n>|list:<file>]";
+    char* file_name = NULL;
+    char* k_value = NULL;
+    ScorerType scorer = SCORER_BM25;
+    ScorerParams params = {1.2f, 0.75f};
+    ImpactOptions impact = {IMPACT_OFF, 0};
+    ReorderMode reorder = REORDER_NONE;
+    OutputMode output = OUTPUT_FULL;
+    long batchMemory = 0;  // bytes per indexing batch, 0 = all in memory
+    BigramOptions bigrams = {BIGRAMS_OFF, 0, NULL};
+    // Options come in "-flag value" pairs, in any order
+    for (int a = 1; a < argc; a += 2) {
+        if (a + 1 >= argc) {
+            cout << usage << endl;
+            return -1;
+        }
+        if (!strcmp(argv[a], "-d")) {
+            file_name = argv[a + 1];
+        } else if (!strcmp(argv[a], "-k")) {
+            k_value = argv[a + 1];
+        } else if (!strcmp(argv[a], "-scorer")) {
+            if (parse_scorer(argv[a + 1], &scorer) == -1) {
+                cout << "Unknown scorer: " << argv[a + 1] << " (use bm25, bm25plus, tfidf or bm25f)" << endl;
+                return -1;
+            }
+        } else if (!strcmp(argv[a], "-impact")) {
+            if (parse_impact(argv[a + 1], &impact) == -1) {
+                cout << "Invalid value for -impact (use full, global:<min impact> or term:<fraction>)" << endl;
+                return -1;
+            }
+        } else if (!strcmp(argv[a], "-output")) {
+            if (parse_output(argv[a + 1], &output) == -1) {
+                cout << "Invalid value for -output (use full, title, snippet or ids)" << endl;
+                return -1;
+            }
+        } else if (!strcmp(argv[a], "-batch-memory")) {
+            char* end;
+            long megabytes = strtol(argv[a + 1], &end, 10);
+            if (*end != '\0' || megabytes < 1) {
+                cout << "Invalid value for -batch-memory (must be a whole number of MB, at least 1)" << endl;
+                return -1;
+            }
+            batchMemory = megabytes * 1024 * 1024;
+        } else if (!strcmp(argv[a], "-bigrams")) {
+            if (parse_bigrams(argv[a + 1], &bigrams) == -1) {
+                cout << "Invalid value for -bigrams (use a minimum pair count of at least 2, or list:<file>)" << endl;
+                return -1;
+            }
+        } else if (!strcmp(argv[a], "-reorder")) {
+            if (parse_reorder(argv[a + 1], &reorder) == -1) {
+                cout << "Invalid value for -reorder (use text, bp or none)" << endl;
+                return -1;
+            }
+        } else if (!strcmp(argv[a], "-k1") || !strcmp(argv[a], "-b")) {
+            char* end;
+            float value = strtof(argv[a + 1], &end);
+            if (*end != '\0' || value < 0) {
+                cout << "Invalid value for " << argv[a] << " (must be a non-negative number)" << endl;
+                return -1;
+            }
+            if (!strcmp(argv[a], "-b") && value > 1) {
+                cout << "Invalid value for -b (must be between 0 and 1)" << endl;
+                return -1;
+            }
+            if (!strcmp(argv[a], "-k1"))
+                params.k1 = value;
+            else
+                params.b = value;
+        } else {
+            cout << usage << endl;
+            return -1;
+        }
+    }
+    if (file_name == NULL || k_value == NULL) {
+        cout << usage << endl;
+        return -1;
+    }
+    if (batchMemory > 0 && reorder == REORDER_TEXT) {
+        cout << "-reorder text needs documents in memory; use -reorder bp with -batch-memory" << endl;
         return -1;
     }
 
     cout << "Please wait..." << endl;
-    int linecounter = 0;
-    int maxlength = -1;
     int k;
     try {
-        k = stoi(argv[4]); 
+        k = stoi(k_value); 
     } catch (...) {
         cout << "Invalid value for -k (must be an integer)" << endl;
         return -1;
     }
-    
-    if(read_sizes(&linecounter, &maxlength,argv[2]) == -1){
+    if (k < 1) {
+        cout << "Invalid value for -k (must be at least 1)" << endl;
         return -1;
     }
 
-    Mymap *mymap=new Mymap(linecounter, maxlength);
-    TrieNode *trie=new TrieNode();
-
-    if(read_input(mymap,trie, argv[2]) == -1){
-        delete (mymap);
-        delete (trie);
+    reload_watch_signal();  // before any other thread starts
+    IndexOptions options = {scorer, params, impact, reorder, batchMemory, bigrams};
+    snapshot_init(options);
+    search_init(scorer, params);
+    search_set_output(output);
+    Snapshot* snapshot = build_snapshot(file_name);
+    if(snapshot == NULL){
         return -1;
     }
-    cout<<"File read successfully. Lines: " << linecounter << ", Max Length: " << maxlength << endl;
+    publish_snapshot(snapshot);
+    cout<<"File read successfully. Lines: " << snapshot->get_lines() << ", Max Length: " << snapshot->get_maxlength() << ", Scorer: " << scorer_name(scorer) << endl;
     char* input=NULL;
     size_t input_length=0;
     while(1){
-        cout << "Enter query (or type '/exit' to /quit): ";
+        lock_output();
+        cout << "Enter query (or type '/exit' to /quit): " << flush;
+        unlock_output();
         if(getline(&input, &input_length, stdin) == -1){
             // EOF or error
             free(input);
             break;
         }
         
-        int ret=inputmanager(input,trie,mymap,k);
+        lock_output();
+        int ret=inputmanager(input,k);
+        cout.flush();
+        unlock_output();
         if(ret==2){
             cout<<"Exiting program..."<<endl;
             free(input);
@@ -82,7 +188,6 @@ int main(int argc, char** argv) {
         // ret == 0 or 1: continue
     }
     
-    delete (mymap);
-    delete (trie);
+    reload_shutdown();  // waits for a running reload, frees the index
     return 0;
-}
\ No newline at end of file
+}
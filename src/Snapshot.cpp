@@ -0,0 +1,252 @@
+#include "Snapshot.hpp"
+#include <sstream>
+#include <chrono>
+using namespace std;
+
+static IndexOptions options;
+static mutex snapshot_lock;   // guards current and every refs count
+static Snapshot* current = NULL;
+static unsigned int id_base = 0;  // from the clock, so ids differ between runs too
+static unsigned int built = 0;    // snapshots made so far
+
+static mutex output_lock;     // held by a command while it prints, and by reload messages
+
+static mutex reload_lock;     // guards the fields below
+static thread builder;        // background /reload build, joined before the next one
+static int building = 0;
+static int shutting_down = 0;
+
+Snapshot::Snapshot(Mymap* map, TrieNode* trie, TrieNode* titles, BigramIndex* bigrams, int impacts, int lines,
+                   int maxlength, const char* path)
+    : map(map), trie(trie), titles(titles), bigrams(bigrams), impacts(impacts), lines(lines), maxlength(maxlength),
+      path(strdup(path)), refs(0)
+{
+    snapshot_lock.lock();
+    id = id_base ^ (++built * 2654435761u);
+    snapshot_lock.unlock();
+}
+
+Snapshot::~Snapshot()
+{
+    delete map;
+    delete trie;
+    delete titles;
+    delete bigrams;
+    free(path);
+}
+
+void snapshot_init(IndexOptions indexOptions)
+{
+    options = indexOptions;
+    unsigned long long now = (unsigned long long)chrono::system_clock::now().time_since_epoch().count();
+    id_base = (unsigned int)(now ^ (now >> 32));
+}
+
+// Builds a complete index for path with the startup options.
+// Returns NULL (after printing why) if the file cannot be indexed.
+Snapshot* build_snapshot(const char* path)
+{
+    int linecounter = 0;
+    int maxlength = -1;
+    char* file_name = strdup(path);
+    if(read_sizes(&linecounter, &maxlength, file_name) == -1){
+        free(file_name);
+        return NULL;
+    }
+    Mymap* map = new Mymap(linecounter, maxlength);
+    TrieNode* trie = new TrieNode();
+    TrieNode* titles = (options.scorer == SCORER_BM25F) ? new TrieNode() : NULL;
+    BigramIndex* bigrams = NULL;
+    int loaded = 1;
+    if(options.bigrams.mode != BIGRAMS_OFF){
+        // Pairs are chosen before indexing so split() only keeps those
+        bigrams = new BigramIndex(options.bigrams.minimum);
+        bigrams->set_limit(options.batch_memory);
+        loaded = options.bigrams.mode == BIGRAMS_LIST
+            ? load_bigram_list(bigrams, options.bigrams.list)
+            : count_bigrams(map, file_name, bigrams);
+        if(loaded != -1)
+            bigrams->select();
+    }
+    if(loaded != -1){
+        loaded = options.batch_memory > 0
+            ? read_input_streaming(map, trie, file_name, titles, bigrams, options.batch_memory)
+            : read_input(map, trie, file_name, titles, bigrams);
+    }
+    free(file_name);
+    if(loaded == -1){
+        delete map;
+        delete trie;
+        delete titles;
+        delete bigrams;
+        return NULL;
+    }
+    reorder_documents(trie, titles, bigrams != NULL ? bigrams->get_pairs() : NULL, map, options.reorder);
+    map->compute_norms(options.params.k1, options.params.b);
+    if(options.scorer == SCORER_BM25F){
+        map->compute_field_norms(options.params.b);
+    }
+    compute_max_weights(trie, titles, map, options.scorer, options.params);
+    build_bitmaps(trie, map);
+    int impacts = options.impact.mode != IMPACT_OFF;
+    if(impacts){
+        build_impacts(trie, titles, map, options.scorer, options.params, options.impact);
+    }
+    return new Snapshot(map, trie, titles, bigrams, impacts, linecounter, maxlength, path);
+}
+
+// Makes snapshot the one new commands see. The previous snapshot loses
+// the reference held for being current and is freed here if no command
+// is still using it, otherwise by the last release_snapshot().
+void publish_snapshot(Snapshot* snapshot)
+{
+    snapshot_lock.lock();
+    Snapshot* old = current;
+    current = snapshot;
+    if(snapshot != NULL){
+        snapshot->refs++;
+    }
+    snapshot_lock.unlock();
+    if(old != NULL){
+        release_snapshot(old);
+    }
+}
+
+Snapshot* acquire_snapshot()
+{
+    snapshot_lock.lock();
+    Snapshot* snapshot = current;
+    if(snapshot != NULL){
+        snapshot->refs++;
+    }
+    snapshot_lock.unlock();
+    return snapshot;
+}
+
+void release_snapshot(Snapshot* snapshot)
+{
+    if(snapshot == NULL){
+        return;
+    }
+    snapshot_lock.lock();
+    int left = --snapshot->refs;
+    snapshot_lock.unlock();
+    if(left == 0){
+        delete snapshot;
+    }
+}
+
+void lock_output()
+{
+    output_lock.lock();
+}
+
+void unlock_output()
+{
+    output_lock.unlock();
+}
+
+// Runs on the builder thread. What the build prints is collected and
+// shown, with the outcome, once the new index is published, so it never
+// lands in the middle of a command's output.
+static void build_and_publish(char* path)
+{
+    ostringstream log;
+    set_build_log(&log);
+    Snapshot* snapshot = build_snapshot(path);
+    set_build_log(NULL);
+    int lines = 0, maxlength = 0;
+    if(snapshot != NULL){
+        lines = snapshot->get_lines();
+        maxlength = snapshot->get_maxlength();
+        publish_snapshot(snapshot);
+    }
+    lock_output();
+    cout << log.str();
+    if(snapshot == NULL){
+        cout << "Reload of " << path << " failed; still serving the previous index" << endl;
+    } else {
+        cout << "Reloaded " << path << ". Lines: " << lines << ", Max Length: " << maxlength << endl;
+    }
+    unlock_output();
+    free(path);
+    reload_lock.lock();
+    building = 0;
+    reload_lock.unlock();
+}
+
+// Starts building path (NULL = the current snapshot's file) on a
+// background thread; commands keep using the current snapshot meanwhile.
+// Returns -1 if a reload is already running, -2 if the first index is
+// not built yet.
+int start_reload(const char* path)
+{
+    char* copy;
+    if(path != NULL){
+        copy = strdup(path);
+    } else {
+        Snapshot* snapshot = acquire_snapshot();
+        if(snapshot == NULL){
+            return -2;
+        }
+        copy = strdup(snapshot->get_path());
+        release_snapshot(snapshot);
+    }
+    reload_lock.lock();
+    if(building || shutting_down){
+        reload_lock.unlock();
+        free(copy);
+        return -1;
+    }
+    if(builder.joinable()){
+        builder.join();  // previous build has already finished
+    }
+    building = 1;
+    builder = thread(build_and_publish, copy);
+    reload_lock.unlock();
+    return 1;
+}
+
+#ifndef _WIN32
+static void watch_signal(sigset_t signals)
+{
+    int received;
+    while(sigwait(&signals, &received) == 0){
+        int started = start_reload(NULL);
+        lock_output();
+        if(started == -2)
+            cout << "SIGHUP ignored: the initial index is still being built" << endl;
+        else if(started == -1)
+            cout << "SIGHUP ignored: a reload is already in progress" << endl;
+        else
+            cout << "SIGHUP received, reloading in the background" << endl;
+        unlock_output();
+    }
+}
+#endif
+
+// SIGHUP re-reads the current file. Must be called before any other
+// thread exists so every thread inherits the blocked signal and only the
+// watcher receives it (through sigwait, outside any handler).
+void reload_watch_signal()
+{
+#ifndef _WIN32
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+    thread(watch_signal, signals).detach();
+#endif
+}
+
+// Waits for a running reload and frees the current snapshot
+void reload_shutdown()
+{
+    reload_lock.lock();
+    shutting_down = 1;
+    reload_lock.unlock();
+    if(builder.joinable()){
+        builder.join();
+    }
+    publish_snapshot(NULL);
+}
@@ -0,0 +1,401 @@
+#include "Spimi.hpp"
+#include "Document_store.hpp"
+#include "Kernels.hpp"
+using namespace std;
+
+const int RUN_SECTIONS = 3;  // body, titles, bigram pairs
+const int RUN_FANIN = 64;    // Runs merged at once; bounds open temporary files
+
+// ------------------------------------------------------------ run writer
+
+struct RunTerm
+{
+    char* word;
+    Postings* postings;
+};
+
+struct RunTerms
+{
+    RunTerm* items;
+    int count;
+    int capacity;
+};
+
+static void collect_term(const char* word, Postings* postings, void* arg)
+{
+    RunTerms* terms = (RunTerms*)arg;
+    if(terms->count == terms->capacity){
+        terms->capacity = terms->capacity > 0 ? terms->capacity * 2 : 64;
+        terms->items = (RunTerm*)realloc(terms->items, terms->capacity*sizeof(RunTerm));
+    }
+    terms->items[terms->count].word = strdup(word);
+    terms->items[terms->count].postings = postings;
+    terms->count++;
+}
+
+static int compare_term(const void* a, const void* b)
+{
+    return strcmp(((const RunTerm*)a)->word, ((const RunTerm*)b)->word);
+}
+
+static int write_record(FILE* run, const char* word, const int* ids, const int* tfs, int count,
+                        unsigned char** bytes, int* bytescap)
+{
+    int wordlen = strlen(word);
+    if(5 * count > *bytescap){
+        *bytescap = 5 * count;
+        *bytes = (unsigned char*)realloc(*bytes, *bytescap);
+    }
+    int idbytes = varint_encode(ids, count, *bytes);
+    if(fwrite(&wordlen, sizeof(int), 1, run) != 1 ||
+       fwrite(word, 1, wordlen, run) != (size_t)wordlen ||
+       fwrite(&count, sizeof(int), 1, run) != 1 ||
+       fwrite(&idbytes, sizeof(int), 1, run) != 1 ||
+       fwrite(*bytes, 1, idbytes, run) != (size_t)idbytes ||
+       fwrite(tfs, sizeof(int), count, run) != (size_t)count){
+        return -1;
+    }
+    return 1;
+}
+
+static int end_section(FILE* run)
+{
+    int end = 0;
+    return fwrite(&end, sizeof(int), 1, run) == 1 ? 1 : -1;
+}
+
+// Run file layout: one section per index (body, titles, bigram pairs),
+// each a record per word in strcmp order followed by an int 0:
+//   int wordlen, word bytes, int count, int idbytes,
+//   docids as gap varints (idbytes), count raw int tfs
+// Adds the heap bytes freezing the batch took (on top of the batch
+// itself) to frozen.
+static int write_section(TrieNode* batch, Mymap* mymap, FILE* run, long* frozen)
+{
+    RunTerms terms;
+    terms.items = NULL;
+    terms.count = 0;
+    terms.capacity = 0;
+    if(batch != NULL){
+        batch->finalize();
+        char* buffer = (char*)malloc((mymap->get_buffersize() + 2)*sizeof(char));
+        batch->visit(buffer, 0, collect_term, &terms);
+        free(buffer);
+        qsort(terms.items, terms.count, sizeof(RunTerm), compare_term);
+        *frozen += heap_bytes(terms.capacity*sizeof(RunTerm));
+        for(int t = 0; t < terms.count; t++){
+            int count = terms.items[t].postings->get_count();
+            *frozen += heap_bytes(strlen(terms.items[t].word) + 1) + heap_bytes(sizeof(Postings)) +
+                       2 * heap_bytes(count*sizeof(int));
+        }
+    }
+
+    int status = 1;
+    unsigned char* bytes = NULL;
+    int bytescap = 0;
+    for(int t = 0; t < terms.count; t++){
+        Postings* postings = terms.items[t].postings;
+        if(write_record(run, terms.items[t].word, postings->get_ids(), postings->get_tfs(), postings->get_count(),
+                        &bytes, &bytescap) == -1){
+            status = -1;
+        }
+        free(terms.items[t].word);
+    }
+    free(bytes);
+    free(terms.items);
+    if(end_section(run) == -1){
+        status = -1;
+    }
+    return status;
+}
+
+static int write_run(TrieNode** batches, Mymap* mymap, FILE* run, long* frozen)
+{
+    int status = 1;
+    for(int s = 0; s < RUN_SECTIONS; s++){
+        if(write_section(batches[s], mymap, run, frozen) == -1)
+            status = -1;
+    }
+    if(fflush(run) != 0 || fseek(run, 0, SEEK_SET) != 0){
+        status = -1;
+    }
+    return status;
+}
+
+// ------------------------------------------------------------ run reader
+
+struct RunReader
+{
+    FILE* file;
+    char* word;       // current word, NULL at the end of a section
+    int wordcap;
+    int count;
+    int idbytes;
+};
+
+static void next_term(RunReader* reader)
+{
+    int wordlen;
+    if(fread(&wordlen, sizeof(int), 1, reader->file) != 1 || wordlen <= 0){
+        free(reader->word);
+        reader->word = NULL;
+        reader->wordcap = 0;
+        return;
+    }
+    if(wordlen + 1 > reader->wordcap){
+        reader->wordcap = wordlen + 1;
+        reader->word = (char*)realloc(reader->word, reader->wordcap);
+    }
+    if(fread(reader->word, 1, wordlen, reader->file) != (size_t)wordlen ||
+       fread(&reader->count, sizeof(int), 1, reader->file) != 1 ||
+       fread(&reader->idbytes, sizeof(int), 1, reader->file) != 1){
+        free(reader->word);
+        reader->word = NULL;
+        reader->wordcap = 0;
+        return;
+    }
+    reader->word[wordlen] = '\0';
+}
+
+// Appends the current word's postings at ids/tfs and advances
+static int read_postings(RunReader* reader, unsigned char** bytes, int* bytescap, int* ids, int* tfs)
+{
+    if(reader->idbytes > *bytescap){
+        *bytescap = reader->idbytes;
+        *bytes = (unsigned char*)realloc(*bytes, *bytescap);
+    }
+    if(fread(*bytes, 1, reader->idbytes, reader->file) != (size_t)reader->idbytes ||
+       fread(tfs, sizeof(int), reader->count, reader->file) != (size_t)reader->count){
+        return -1;
+    }
+    varint_decode(*bytes, reader->count, ids);
+    next_term(reader);
+    return 1;
+}
+
+// k-way merge of the current section of every reader: runs cover
+// increasing docid ranges, so a word's postings are just the runs' lists
+// concatenated in run order. Goes into trie, or as a section of out.
+static int merge_section(RunReader* readers, int numruns, TrieNode* trie, FILE* out)
+{
+    for(int r = 0; r < numruns; r++){
+        next_term(&readers[r]);
+    }
+    unsigned char* bytes = NULL;
+    int bytescap = 0;
+    int status = 1;
+    char* word = NULL;
+    int wordcap = 0;
+    while(status == 1){
+        int smallest = -1;
+        for(int r = 0; r < numruns; r++){
+            if(readers[r].word != NULL &&
+               (smallest == -1 || strcmp(readers[r].word, readers[smallest].word) < 0))
+                smallest = r;
+        }
+        if(smallest == -1)
+            break;
+        int wordlen = strlen(readers[smallest].word);
+        if(wordlen + 1 > wordcap){
+            wordcap = wordlen + 1;
+            word = (char*)realloc(word, wordcap);
+        }
+        strcpy(word, readers[smallest].word);
+        int total = 0;
+        for(int r = 0; r < numruns; r++){
+            if(readers[r].word != NULL && !strcmp(readers[r].word, word))
+                total += readers[r].count;
+        }
+        int* ids = (int*)malloc(total*sizeof(int));
+        int* tfs = (int*)malloc(total*sizeof(int));
+        int filled = 0;
+        for(int r = 0; r < numruns && status == 1; r++){
+            if(readers[r].word != NULL && !strcmp(readers[r].word, word)){
+                int count = readers[r].count;
+                status = read_postings(&readers[r], &bytes, &bytescap, ids + filled, tfs + filled);
+                filled += count;
+            }
+        }
+        if(out != NULL){
+            if(status == 1)
+                status = write_record(out, word, ids, tfs, total, &bytes, &bytescap);
+            free(ids);
+            free(tfs);
+        } else if(trie != NULL){
+            trie->attach(word, new Postings(ids, tfs, total));
+        } else {
+            free(ids);
+            free(tfs);
+        }
+    }
+    if(out != NULL && status == 1){
+        status = end_section(out);
+    }
+    free(bytes);
+    free(word);
+    return status;
+}
+
+// Merges every section of runs into targets (one trie per section, NULL
+// to skip it), or into the run out
+static int merge_runs(FILE** runs, int numruns, TrieNode** targets, FILE* out)
+{
+    RunReader* readers = (RunReader*)calloc(numruns, sizeof(RunReader));
+    for(int r = 0; r < numruns; r++){
+        readers[r].file = runs[r];
+    }
+    int status = 1;
+    for(int s = 0; s < RUN_SECTIONS && status == 1; s++){
+        status = merge_section(readers, numruns, out != NULL ? NULL : targets[s], out);
+    }
+    for(int r = 0; r < numruns; r++){
+        free(readers[r].word);
+    }
+    free(readers);
+    if(out != NULL && status == 1 && (fflush(out) != 0 || fseek(out, 0, SEEK_SET) != 0)){
+        status = -1;
+    }
+    return status;
+}
+
+// Runs are kept in docid order with levels[r] the number of merges behind
+// run r, never increasing along the array. When the last RUN_FANIN runs
+// share a level they become one run of the next level, so at most
+// RUN_FANIN - 1 files per level stay open.
+static int add_run(FILE*** runs, int** levels, int* numruns, FILE* run, int* merges)
+{
+    *runs = (FILE**)realloc(*runs, (*numruns + 1)*sizeof(FILE*));
+    *levels = (int*)realloc(*levels, (*numruns + 1)*sizeof(int));
+    (*runs)[*numruns] = run;
+    (*levels)[*numruns] = 0;
+    (*numruns)++;
+    while(*numruns >= RUN_FANIN && (*levels)[*numruns - RUN_FANIN] == (*levels)[*numruns - 1]){
+        int first = *numruns - RUN_FANIN;
+        FILE* merged = tmpfile();
+        if(merged == NULL || merge_runs(*runs + first, RUN_FANIN, NULL, merged) == -1){
+            if(merged != NULL)
+                fclose(merged);
+            return -1;
+        }
+        for(int r = first; r < *numruns; r++){
+            fclose((*runs)[r]);
+        }
+        (*runs)[first] = merged;
+        (*levels)[first]++;
+        *numruns = first + 1;
+        (*merges)++;
+    }
+    return 1;
+}
+
+// ---------------------------------------------------------------- build
+
+int read_input_streaming(Mymap* mymap, TrieNode* trie, char* file_name, TrieNode* titles, BigramIndex* bigrams,
+                         long budget)
+{
+    FILE *file = fopen(file_name, "r");
+    FILE *source = fopen(file_name, "r");
+    if(file == NULL || source == NULL){
+        build_log() << "Error opening file: " << file_name << endl;
+        if(file != NULL)
+            fclose(file);
+        if(source != NULL)
+            fclose(source);
+        return -1;
+    }
+    mymap->set_source(source);
+
+    // The selected-pair table stays for the whole build and the rest is
+    // what one batch may take at its peak, while it is frozen and written.
+    // Freezing can take more than the batch itself (a Postings, two
+    // arrays and a copy of the word per term), so the first batch is cut
+    // at a quarter of that; after each one the limit is set from how much
+    // freezing it actually added, an eighth short since the next batch
+    // mixes new and known words differently.
+    long fixed = bigrams != NULL ? bigrams->table_bytes() : 0;
+    long available = budget - fixed;
+    if(available < budget / 4)
+        available = budget / 4;
+    long batchlimit = available / 4;
+
+    FILE** runs = NULL;
+    int* levels = NULL;
+    int numruns = 0, written = 0, merges = 0;
+    TrieNode* batch = new TrieNode();
+    TrieNode* batchtitles = titles != NULL ? new TrieNode() : NULL;
+    long batchbytes = 0;
+    long peakbytes = 0;
+    int status = 1;
+    char *line = NULL;
+    size_t buffersize = 0;
+    for(int i=0;i<mymap->get_size() && status == 1;i++){
+        long offset = ftell(file);
+        if(getline(&line, &buffersize, file) == -1){
+            build_log() << "Error reading line " << i << endl;
+            status = -1;
+            break;
+        }
+        char* text = mymap->insert_offset(line, offset, i);
+        if(text == NULL){
+            build_log() << "Error inserting line " << endl;
+            status = -1;
+            break;
+        }
+        batchbytes += split(text, i, batch, mymap, batchtitles, bigrams);
+        if(batchbytes >= batchlimit || i == mymap->get_size() - 1){
+            TrieNode* batches[RUN_SECTIONS] = {batch, batchtitles, bigrams != NULL ? bigrams->take_pairs() : NULL};
+            FILE* run = tmpfile();
+            long frozen = 0;
+            if(run == NULL || write_run(batches, mymap, run, &frozen) == -1){
+                build_log() << "Error writing index run to a temporary file" << endl;
+                if(run != NULL)
+                    fclose(run);
+                status = -1;
+            } else if(add_run(&runs, &levels, &numruns, run, &merges) == -1){
+                build_log() << "Error merging index runs" << endl;
+                status = -1;
+            }
+            written++;
+            if(batchbytes + frozen > peakbytes)
+                peakbytes = batchbytes + frozen;
+            if(batchbytes > 0)
+                batchlimit = (long)(0.875 * available * batchbytes / (batchbytes + frozen));
+            for(int s = 0; s < RUN_SECTIONS; s++){
+                delete batches[s];
+            }
+            batch = new TrieNode();
+            batchtitles = titles != NULL ? new TrieNode() : NULL;
+            batchbytes = 0;
+        }
+    }
+    delete batch;
+    delete batchtitles;
+    free(line);
+    fclose(file);
+
+    TrieNode* targets[RUN_SECTIONS] = {trie, titles, bigrams != NULL ? bigrams->get_pairs() : NULL};
+    if(status == 1 && merge_runs(runs, numruns, targets, NULL) == -1){
+        build_log() << "Error reading back index runs" << endl;
+        status = -1;
+    }
+    for(int r = 0; r < numruns; r++){
+        fclose(runs[r]);
+    }
+    free(runs);
+    free(levels);
+    if(status == 1){
+        if(bigrams != NULL)
+            bigrams->finalize();
+        build_log() << "Streaming build: " << written << " run(s)";
+        if(merges > 0)
+            build_log() << ", " << merges << " intermediate merge(s) of " << RUN_FANIN;
+        build_log() << ", largest batch " << peakbytes / 1024 << " KB while written";
+        if(bigrams != NULL)
+            build_log() << " plus the " << fixed / 1024 << " KB pair table";
+        build_log() << ", of " << budget / 1024 << " KB budget";
+        if(peakbytes > available)
+            build_log() << " (over budget)";
+        build_log() << endl;
+    }
+    return status;
+}
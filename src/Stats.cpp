@@ -0,0 +1,63 @@
+#include "Stats.hpp"
+#include "Kernels.hpp"
+using namespace std;
+
+struct IndexStats
+{
+    long terms;
+    long postings;
+    long varint_bytes;    // docids as gap varints
+    long impact_postings; // kept in the impact-ordered lists
+    long bitmap_terms;
+    long bitmap_bytes;
+    long bitmap_postings; // postings of the words whose ids are a bitmap
+    int* ids;             // room to decode one
+};
+
+static void count_term(const char*, Postings* postings, void* arg)
+{
+    IndexStats* s = (IndexStats*)arg;
+    s->terms++;
+    s->postings += postings->get_count();
+    s->varint_bytes += varint_size(postings->decode_ids(s->ids), postings->get_count());
+    s->impact_postings += postings->get_impact_count();
+    if(postings->get_bitmap() != NULL){
+        s->bitmap_terms++;
+        s->bitmap_bytes += postings->get_bitmap()->bytes();
+        s->bitmap_postings += postings->get_count();
+    }
+}
+
+void stats(TrieNode* trie, Mymap* map, BigramIndex* bigrams)
+{
+    IndexStats s, pairs;
+    memset(&s, 0, sizeof(s));
+    memset(&pairs, 0, sizeof(pairs));
+    s.ids = (int*)malloc((map->get_size() > 0 ? map->get_size() : 1)*sizeof(int));
+    char* buffer = (char*)malloc((map->get_buffersize() + 2)*sizeof(char));
+    trie->visit(buffer, 0, count_term, &s);
+    if(bigrams != NULL)
+        bigrams->get_pairs()->visit(buffer, 0, count_term, &pairs);
+    free(buffer);
+    free(s.ids);
+
+    // A bitmap word keeps its tfs array and the bitmap instead of its ids
+    long rawBytes = s.postings * (long)(2 * sizeof(int)) - s.bitmap_postings * (long)sizeof(int) + s.bitmap_bytes;
+    cout << "Documents: " << map->get_size() << ", avg length: " << map->get_avgdl() << " words" << endl;
+    cout << "Terms: " << s.terms << ", postings: " << s.postings << endl;
+    cout << "Postings size: " << rawBytes << " bytes (docids as varint gaps: " << s.varint_bytes << " bytes)" << endl;
+    if(s.bitmap_terms > 0){
+        cout << "Bitmaps: " << s.bitmap_terms << " words, " << s.bitmap_bytes << " bytes in place of "
+             << s.bitmap_postings * (long)sizeof(int) << " bytes of docid arrays" << endl;
+    }
+    if(bigrams != NULL){
+        cout << "Bigrams: " << pairs.terms << " pairs, " << pairs.postings << " postings, "
+             << pairs.postings * (long)(2 * sizeof(int)) << " bytes" << endl;
+    }
+    if(s.impact_postings > 0){
+        long impactBytes = s.impact_postings * (long)(sizeof(int) + sizeof(double));
+        cout << "Impact postings: " << s.impact_postings << " kept ("
+             << (s.postings > 0 ? 100.0 * s.impact_postings / s.postings : 0) << "%), "
+             << impactBytes << " bytes" << endl;
+    }
+}
@@ -4,9 +4,27 @@
 #include <fstream>
 using namespace std;
 
+#if defined(__GNUC__) || defined(__clang__)
+    #define TRIE_PREFETCH(address) __builtin_prefetch(address)
+#else
+    #define TRIE_PREFETCH(address) ((void)(address))
+#endif
+
+const int LOOKUP_LANES = 16;  // Words walked at the same time by lookup()
+
+// Heap bytes behind a new of size bytes: malloc adds an 8-byte header,
+// rounds up to 16 and hands out at least 32
+long heap_bytes(size_t size)
+{
+    long chunk = (long)((size + 8 + 15) & ~(size_t)15);
+    return chunk < 32 ? 32 : chunk;
+}
+
 TrieNode::TrieNode():value(-1), sibling(nullptr), child(nullptr)
 {
     list = nullptr;
+    tail = nullptr;
+    postings = nullptr;
 };
 
 TrieNode::~TrieNode()
@@ -14,6 +32,9 @@ TrieNode::~TrieNode()
     if(list!=nullptr){
         delete list;
     }
+    if(postings!=nullptr){
+        delete postings;
+    }
     if(sibling!=nullptr){
         delete sibling;
     }
@@ -22,34 +43,45 @@ TrieNode::~TrieNode()
     }
 
 };
-void TrieNode::insert(char* token, int id){
+// Returns the heap bytes taken by new nodes (used to bound batch memory)
+long TrieNode::insert(char* token, int id){
+    long bytes=0;
     if(value ==-1 || value ==token[0]){
         value = token[0];
         if(strlen(token)==1){
-            if(list==nullptr)
-                list=new listnode(id);
-            list->add(id);
+            if(list==nullptr){
+                list=tail=new listnode(id);
+                bytes+=heap_bytes(sizeof(listnode));
+            }
+            else{
+                listnode* last=tail;
+                tail=tail->append(id);
+                if(tail!=last)
+                    bytes+=heap_bytes(sizeof(listnode));
+            }
         }
         else{
             if(child == nullptr){
                 child = new TrieNode();
+                bytes+=heap_bytes(sizeof(TrieNode));
             }
-            child->insert(token+1,id);
+            bytes+=child->insert(token+1,id);
         }
     }
     else{
         if(sibling==nullptr){
             sibling=new TrieNode();
+            bytes+=heap_bytes(sizeof(TrieNode));
         }
-        sibling->insert(token,id);
+        bytes+=sibling->insert(token,id);
     }
-    return ;
+    return bytes;
 }
 int TrieNode::dfsearchword(char* word, int curr, int wordlen){
     if(word[curr]==value){
         if(curr==wordlen-1){
-            if(list!=NULL){
-                return list->volume();
+            if(postings!=NULL){
+                return postings->get_count();
             }
             else{
                 return 0;
@@ -73,8 +105,8 @@ int TrieNode::dfsearchword(char* word, int curr, int wordlen){
 int TrieNode::tfsearchword(int id, char* word, int curr, int wordlen){
     if(word[curr]==value){
         if(curr==wordlen-1){
-            if(list!=NULL){
-                return list->search(id);
+            if(postings!=NULL){
+                return postings->search(id);
             }else{
                 return 0;
             }
@@ -112,34 +144,167 @@ void TrieNode::searchall(char* buffer, int curr){
     buffer [ curr ] = '\0';
 }
 */
-void TrieNode::search(char* word, int curr, Scorelist* scorelist){
-    static int wordlen = strlen(word);
-    if(curr == 0) wordlen = strlen(word);  // Reset on first call
-    
-    if(word[curr]==value){
-        if(curr==wordlen-1){
-            if(list!=NULL){
-                list->passdocuments(scorelist);
-                return;
-            }
-            else{ 
-                return;
+
+// Freeze every listnode chain into a contiguous Postings block.
+// Called once after indexing; queries only read the frozen postings.
+void TrieNode::finalize(){
+    for(TrieNode* node=this; node!=nullptr; node=node->sibling){
+        if(node->list!=nullptr){
+            node->postings=new Postings(node->list);
+            delete node->list;
+            node->list=nullptr;
+            node->tail=nullptr;
+        }
+        if(node->child!=nullptr){
+            node->child->finalize();
+        }
+    }
+}
+Postings* TrieNode::find(char* word, int curr, int wordlen){
+    TrieNode* node=this;
+    while(node!=nullptr){
+        if(word[curr]==node->value){
+            if(curr==wordlen-1){
+                return node->postings;
             }
+            node=node->child;
+            curr++;
         }
         else{
-            if(child!=NULL){
-                child->search(word, curr+1, scorelist);
-                return;
+            node=node->sibling;
+        }
+    }
+    return nullptr;
+}
+
+// One word in flight in lookup(): the node it reads next (prefetched
+// when the lane moved there), or the postings it found
+struct LookupLane
+{
+    TrieNode* node;
+    Postings* postings;
+    const char* word;
+    int curr;
+    int wordlen;
+    int index;  // where the result goes, -1 if the lane is idle
+};
+
+// Batched find(): results[i] = postings of words[i], NULL if absent.
+// A single walk is a chain of dependent cache misses (every node is its
+// own allocation), so up to LOOKUP_LANES walks are interleaved, one step
+// each per round, and every step prefetches the node the lane reads in
+// the next round. A found word also prefetches its Postings and then the
+// start of its id array, which the query reads right after.
+void TrieNode::lookup(const char* const* words, int nwords, Postings** results){
+    if(nwords==1){
+        // Nothing to overlap with; the plain walk has less bookkeeping
+        int wordlen=strlen(words[0]);
+        results[0]=wordlen>0 ? find((char*)words[0], 0, wordlen) : nullptr;
+        return;
+    }
+    LookupLane lanes[LOOKUP_LANES];
+    int width=nwords<LOOKUP_LANES ? nwords : LOOKUP_LANES;
+    int next=0, active=0;
+    for(int l=0;l<width;l++){
+        lanes[l].index=-1;
+    }
+    while(next<nwords || active>0){
+        for(int l=0;l<width;l++){
+            LookupLane* lane=&lanes[l];
+            if(lane->index==-1){
+                // Refill an idle lane with the next word
+                if(next>=nwords){
+                    continue;
+                }
+                lane->index=next;
+                lane->word=words[next];
+                lane->wordlen=strlen(words[next]);
+                lane->curr=0;
+                lane->node=lane->wordlen>0 ? this : nullptr;
+                lane->postings=nullptr;
+                next++;
+                active++;
+                TRIE_PREFETCH(lane->node);
+                if(lane->node!=nullptr){
+                    continue;
+                }
+            }
+            if(lane->postings!=nullptr){
+                // The Postings arrived last round; now its tfs (every
+                // list has them, a bitmap word has no id array)
+                TRIE_PREFETCH(lane->postings->get_tfs());
+                results[lane->index]=lane->postings;
+                lane->index=-1;
+                active--;
+                continue;
+            }
+            TrieNode* node=lane->node;
+            if(node==nullptr){
+                results[lane->index]=nullptr;
+                lane->index=-1;
+                active--;
+                continue;
+            }
+            if(lane->word[lane->curr]==node->value){
+                if(lane->curr==lane->wordlen-1){
+                    lane->postings=node->postings;
+                    lane->node=nullptr;
+                    TRIE_PREFETCH(lane->postings);
+                    continue;
+                }
+                lane->node=node->child;
+                lane->curr++;
             }
             else{
-                return;
+                lane->node=node->sibling;
             }
+            TRIE_PREFETCH(lane->node);
         }
     }
-    else{
-        if(sibling!=NULL){
-            sibling->search(word, curr, scorelist);
+}
+
+// Walk every word in the trie. buffer must hold the longest word + 1
+// (the longest document is always enough).
+void TrieNode::visit(char* buffer, int curr, TermVisitor visitor, void* arg){
+    for(TrieNode* node=this; node!=nullptr; node=node->sibling){
+        buffer[curr]=node->value;
+        if(node->postings!=nullptr){
+            buffer[curr+1]='\0';
+            visitor(buffer, node->postings, arg);
+        }
+        if(node->child!=nullptr){
+            node->child->visit(buffer, curr+1, visitor, arg);
         }
     }
+    buffer[curr]='\0';
 }
 
+// Hang ready-made postings (e.g. merged from disk runs) under word
+void TrieNode::attach(const char* word, Postings* newpostings){
+    TrieNode* node=this;
+    int curr=0;
+    int wordlen=strlen(word);
+    while(1){
+        if(node->value==-1){
+            node->value=word[curr];
+        }
+        if(node->value==word[curr]){
+            if(curr==wordlen-1){
+                delete node->postings;
+                node->postings=newpostings;
+                return;
+            }
+            if(node->child==nullptr){
+                node->child=new TrieNode();
+            }
+            node=node->child;
+            curr++;
+        }
+        else{
+            if(node->sibling==nullptr){
+                node->sibling=new TrieNode();
+            }
+            node=node->sibling;
+        }
+    }
+}